@@ -0,0 +1,102 @@
+#include "mavalloc.hpp"
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+/*
+*
+* Compares the cost of creating and destroying short lived coroutine
+* frames with the global operator new against mavalloc::frame_cache.
+*
+* Usage: bench_frames [frames]
+*
+*/
+
+// A coroutine that adds its arguments once resumed
+template< typename Base >
+struct bench_task
+{
+  struct promise_type : Base
+  {
+    long value = 0;
+
+    bench_task get_return_object( )
+    {
+      return bench_task{ std::coroutine_handle< promise_type >::from_promise( *this ) };
+    }
+
+    std::suspend_always initial_suspend( ) noexcept { return { }; }
+    std::suspend_always final_suspend( ) noexcept { return { }; }
+    void return_value( long v ) { value = v; }
+    void unhandled_exception( ) { std::terminate( ); }
+  };
+
+  std::coroutine_handle< promise_type > handle;
+};
+
+// Promise base that leaves the frames to the global operator new
+struct default_frames
+{
+};
+
+template< typename Base >
+bench_task< Base > add_frame( long a, long b )
+{
+  // Locals that live across the suspension make the frame a few
+  // hundred bytes, like a typical request handler
+  volatile long scratch[ 32 ];
+
+  scratch[ 0 ] = a;
+  co_await std::suspend_always{ };
+  co_return scratch[ 0 ] + b;
+}
+
+template< typename Base >
+double run( long frames, long * sum )
+{
+  auto start = std::chrono::steady_clock::now( );
+  long i;
+
+  for( i = 0; i < frames; i++ )
+  {
+    bench_task< Base > task = add_frame< Base >( i, 1 );
+
+    task.handle.resume( );
+    task.handle.resume( );
+    *sum = *sum + task.handle.promise( ).value;
+    task.handle.destroy( );
+  }
+
+  std::chrono::duration< double, std::nano > elapsed = std::chrono::steady_clock::now( ) - start;
+
+  return elapsed.count( ) / frames;
+}
+
+int main( int argc, char * argv[] )
+{
+  long frames = ( argc > 1 ) ? atol( argv[ 1 ] ) : 1000000;
+  long sum = 0;
+
+  if( frames <= 0 ) frames = 1;
+
+  mavalloc_init( 1024 * 1024, FIRST_FIT );
+
+  // Warm up both paths before timing them
+  run< default_frames >( 1000, &sum );
+  run< mavalloc::frame_promise_base >( 1000, &sum );
+
+  double heap_ns = run< default_frames >( frames, &sum );
+  double arena_ns = run< mavalloc::frame_promise_base >( frames, &sum );
+
+  printf( "frames:            %ld\n", frames );
+  printf( "operator new:      %.1f ns per frame\n", heap_ns );
+  printf( "frame_cache:       %.1f ns per frame\n", arena_ns );
+  printf( "checksum:          %ld\n", sum );
+
+  mavalloc::frame_cache::drain( );
+  mavalloc_destroy( );
+
+  return 0;
+}
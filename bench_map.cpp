@@ -0,0 +1,97 @@
+#include "mavalloc.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+*
+* Compares insert and erase throughput of std::map and std::unordered_map
+* with std::allocator against mavalloc::allocator on a node_pool.
+*
+* Usage: bench_map [keys] [rounds]
+*
+*/
+
+typedef std::pair< const int, int > entry;
+
+// Inserts every key, then erases them in the same shuffled order
+template< typename Map >
+double run( Map & map, const std::vector< int > & keys, int rounds, long * sum )
+{
+  auto start = std::chrono::steady_clock::now( );
+  int round;
+
+  for( round = 0; round < rounds; round++ )
+  {
+    for( int key : keys ) map.emplace( key, key );
+
+    *sum = *sum + ( long ) map.size( );
+
+    for( int key : keys ) map.erase( key );
+  }
+
+  std::chrono::duration< double > elapsed = std::chrono::steady_clock::now( ) - start;
+
+  // Millions of inserts and erases per second
+  return 2.0 * keys.size( ) * rounds / elapsed.count( ) / 1e6;
+}
+
+int main( int argc, char * argv[] )
+{
+  int count = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 100000;
+  int rounds = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 10;
+  long sum = 0;
+  int i;
+
+  if( count <= 0 ) count = 1;
+  if( rounds <= 0 ) rounds = 1;
+
+  std::vector< int > keys( count );
+
+  srand( 1 );
+  for( i = 0; i < count; i++ ) keys[ i ] = i;
+  for( i = count - 1; i > 0; i-- ) std::swap( keys[ i ], keys[ rand( ) % ( i + 1 ) ] );
+
+  mavalloc_init( 64 * 1024 * 1024, FIRST_FIT );
+
+  double map_std, map_pool, hash_std, hash_pool;
+
+  {
+    std::map< int, int > map;
+    map_std = run( map, keys, rounds, &sum );
+  }
+
+  {
+    mavalloc::node_pool pool;
+    std::map< int, int, std::less< int >, mavalloc::allocator< entry > > map( ( mavalloc::allocator< entry >( &pool ) ) );
+    map_pool = run( map, keys, rounds, &sum );
+  }
+
+  {
+    std::unordered_map< int, int > map;
+    hash_std = run( map, keys, rounds, &sum );
+  }
+
+  {
+    mavalloc::node_pool pool;
+    std::unordered_map< int, int, std::hash< int >, std::equal_to< int >, mavalloc::allocator< entry > >
+      map( 0, std::hash< int >( ), std::equal_to< int >( ), mavalloc::allocator< entry >( &pool ) );
+    hash_pool = run( map, keys, rounds, &sum );
+  }
+
+  printf( "keys: %d, rounds: %d\n", count, rounds );
+  printf( "std::map            std::allocator:       %.2f Mops/s\n", map_std );
+  printf( "std::map            mavalloc::allocator:  %.2f Mops/s\n", map_pool );
+  printf( "std::unordered_map  std::allocator:       %.2f Mops/s\n", hash_std );
+  printf( "std::unordered_map  mavalloc::allocator:  %.2f Mops/s\n", hash_pool );
+  printf( "checksum: %ld\n", sum );
+
+  mavalloc_destroy( );
+
+  return 0;
+}
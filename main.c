@@ -1,7 +1,10 @@
 #include "mavalloc.h"
 #include "tinytest.h"
+#include <errno.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 /*
 *
 * TEST CASE 1: Test init and a single allocation
@@ -638,6 +641,1545 @@ int test_case_20()
   return 1;
 }
 
+/*
+*
+* TEST CASE 21: Test Bitmap allocation, freeing and reuse of runs
+*
+*/
+int test_case_21()
+{
+  mavalloc_set_bitmap_unit( 16 );
+  mavalloc_init( 4096, BITMAP );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 16 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 1 );
+
+  // If you failed here one of your bitmap allocations failed
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  // If you failed here your runs are not rounded up to whole units
+  TINYTEST_EQUAL( ptr2 - ptr1, 112 ); 
+  TINYTEST_EQUAL( ptr3 - ptr2, 16 ); 
+
+  // Three used runs and the trailing free run
+  TINYTEST_EQUAL( mavalloc_size(), 4 ); 
+
+  mavalloc_free( ptr2 );
+
+  char * ptr4 = ( char * ) mavalloc_alloc ( 12 );
+
+  // If you failed here the freed run was not reused
+  TINYTEST_EQUAL( ptr2, ptr4 ); 
+
+  mavalloc_free( ptr1 );
+  mavalloc_free( ptr3 );
+  mavalloc_free( ptr4 );
+
+  // If you failed here freeing did not clear the whole run
+  TINYTEST_EQUAL( mavalloc_size(), 1 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 22: Test Bitmap runs that cross words and filling the arena
+*
+*/
+int test_case_22()
+{
+  mavalloc_set_bitmap_unit( 64 );
+  mavalloc_init( 64 * 200, BITMAP );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 64 * 60 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 64 * 70 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 64 * 70 );
+
+  // If you failed here one of your bitmap allocations failed
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  // If you failed here a run that crosses a word boundary was misplaced
+  TINYTEST_EQUAL( ptr2 - ptr1, 64 * 60 ); 
+  TINYTEST_EQUAL( ptr3 - ptr2, 64 * 70 ); 
+
+  // No units remain free
+  char * ptr4 = ( char * ) mavalloc_alloc ( 1 );
+  TINYTEST_EQUAL( ptr4, NULL ); 
+
+  mavalloc_free( ptr2 );
+
+  char * ptr5 = ( char * ) mavalloc_alloc ( 64 * 70 );
+
+  // If you failed here the freed run was not found again
+  TINYTEST_EQUAL( ptr2, ptr5 ); 
+
+  memcpy( ptr5, "THIS IS THE TEST STRING", 23);
+  TINYTEST_EQUAL( memcmp( ptr5, "THIS IS THE TEST STRING", 23 ), 0 ); 
+
+  mavalloc_destroy( );
+  mavalloc_set_bitmap_unit( MAVALLOC_BITMAP_UNIT );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 23: Test Ring allocation in arrival order and wrapping around
+*
+*/
+int test_case_23()
+{
+  mavalloc_init( 1024, RING );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 300 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 300 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 300 );
+
+  // If you failed here one of your ring allocations failed
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  // If you failed here your ring did not allocate in arrival order
+  TINYTEST_ASSERT( ptr1 < ptr2 && ptr2 < ptr3 ); 
+
+  // The buffer is full until the oldest block is freed
+  TINYTEST_EQUAL( mavalloc_alloc( 300 ), NULL ); 
+
+  mavalloc_free( ptr1 );
+
+  char * ptr4 = ( char * ) mavalloc_alloc ( 300 );
+
+  // If you failed here your ring did not wrap around to the freed head
+  TINYTEST_EQUAL( ptr1, ptr4 ); 
+
+  // ptr2, ptr3, the padding skipped at the end of the arena and ptr4
+  TINYTEST_EQUAL( mavalloc_size(), 4 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 24: Test Ring holding blocks freed out of order
+*
+*/
+int test_case_24()
+{
+  mavalloc_init( 1024, RING );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 300 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 300 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 300 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  // ptr2 is not the oldest block so its space is held
+  mavalloc_free( ptr2 );
+  TINYTEST_EQUAL( mavalloc_size(), 3 ); 
+  TINYTEST_EQUAL( mavalloc_alloc( 300 ), NULL ); 
+
+  // Freeing the oldest block releases both it and the held block
+  mavalloc_free( ptr1 );
+  TINYTEST_EQUAL( mavalloc_size(), 1 ); 
+
+  mavalloc_free( ptr3 );
+  TINYTEST_EQUAL( mavalloc_size(), 0 ); 
+
+  char * ptr4 = ( char * ) mavalloc_alloc ( 1000 );
+
+  // If you failed here your empty ring did not start over
+  TINYTEST_EQUAL( ptr1, ptr4 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 25: Test Quick-fit reusing a freed block of the same size
+*
+*/
+int test_case_25()
+{
+  mavalloc_init( 65535, BEST_FIT );
+  mavalloc_quickfit( 4, 8 );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 64 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 128 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 64 );
+
+  // If you failed here one of your allocations failed
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  mavalloc_free( ptr1 );
+
+  // The cached block keeps its node instead of coalescing
+  TINYTEST_EQUAL( mavalloc_size(), 4 ); 
+
+  char * ptr4 = ( char * ) mavalloc_alloc ( 128 );
+  char * ptr5 = ( char * ) mavalloc_alloc ( 64 );
+
+  // If you failed here a different size was served from the quick-fit list
+  TINYTEST_ASSERT( ptr4 != ptr1 ); 
+
+  // If you failed here the cached block was not handed back out
+  TINYTEST_EQUAL( ptr1, ptr5 ); 
+
+  mavalloc_quickfit( 0, 0 );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 26: Test Quick-fit returning cached blocks when the arena is full
+*
+*/
+int test_case_26()
+{
+  mavalloc_init( 1024, FIRST_FIT );
+  mavalloc_quickfit( 2, 4 );
+
+  // If you failed here the size could not be reserved
+  TINYTEST_EQUAL( mavalloc_quickfit_size( 512 ), 0 ); 
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 512 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 512 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+
+  mavalloc_free( ptr1 );
+  mavalloc_free( ptr2 );
+
+  // Both blocks are cached
+  TINYTEST_EQUAL( mavalloc_size(), 2 ); 
+
+  char * ptr3 = ( char * ) mavalloc_alloc ( 1024 );
+
+  // If you failed here the cached blocks were not coalesced to make room
+  TINYTEST_EQUAL( ptr1, ptr3 ); 
+  TINYTEST_EQUAL( mavalloc_size(), 1 ); 
+
+  mavalloc_quickfit( 0, 0 );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 27: Test the split threshold handing out whole holes
+*
+*/
+int test_case_27()
+{
+  struct mavalloc_stats stats;
+
+  mavalloc_init( 1024, FIRST_FIT );
+  mavalloc_set_split_threshold( 64 );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 1000 );
+
+  // If you failed here your allocation failed
+  TINYTEST_ASSERT( ptr1 ); 
+
+  // If you failed here a sliver hole was split off
+  TINYTEST_EQUAL( mavalloc_size(), 1 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.unsplit_allocations, 1 ); 
+  TINYTEST_EQUAL( stats.unsplit_slack_bytes, 24 ); 
+
+  mavalloc_free( ptr1 );
+
+  char * ptr2 = ( char * ) mavalloc_alloc ( 512 );
+
+  // If you failed here a large enough remainder was not split off
+  TINYTEST_EQUAL( ptr1, ptr2 ); 
+  TINYTEST_EQUAL( mavalloc_size(), 2 ); 
+
+  mavalloc_set_split_threshold( 0 );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 28: Test size-class rounding policies
+*
+*/
+int test_case_28()
+{
+  struct mavalloc_stats stats;
+
+  mavalloc_init( 65535, FIRST_FIT );
+  mavalloc_set_rounding( ROUND_GEOMETRIC, 0 );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 17 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 33 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 100 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  // If you failed here the geometric size classes are wrong
+  TINYTEST_EQUAL( ptr2 - ptr1, 20 ); 
+  TINYTEST_EQUAL( ptr3 - ptr2, 40 ); 
+
+  mavalloc_set_rounding( ROUND_POWER_OF_TWO, 0 );
+  char * ptr4 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr5 = ( char * ) mavalloc_alloc ( 4 );
+  TINYTEST_EQUAL( ptr5 - ptr4, 128 ); 
+
+  // If you failed here an invalid quantum was accepted
+  TINYTEST_EQUAL( mavalloc_set_rounding( ROUND_QUANTUM, 6 ), -1 ); 
+
+  mavalloc_set_rounding( ROUND_QUANTUM, 64 );
+  char * ptr6 = ( char * ) mavalloc_alloc ( 65 );
+  char * ptr7 = ( char * ) mavalloc_alloc ( 4 );
+  TINYTEST_EQUAL( ptr7 - ptr6, 128 ); 
+
+  // 3 + 7 + 12 + 28 + 0 + 63 + 60 bytes of rounding
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.requested_bytes, 323 ); 
+  TINYTEST_EQUAL( stats.rounding_slack_bytes, 173 ); 
+
+  mavalloc_set_rounding( ROUND_ALIGN4, 0 );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 29: Test large allocations bypassing the arena
+*
+*/
+int test_case_29()
+{
+  struct mavalloc_stats stats;
+  char * ptrs[ 40 ];
+  int i;
+
+  mavalloc_init( 65535, BEST_FIT );
+  mavalloc_set_mmap_threshold( 32768 );
+
+  char * small = ( char * ) mavalloc_alloc ( 1000 );
+  char * large = ( char * ) mavalloc_alloc ( 100000 );
+
+  TINYTEST_ASSERT( small ); 
+  TINYTEST_ASSERT( large ); 
+
+  // If you failed here the large block came out of the arena
+  TINYTEST_EQUAL( mavalloc_size(), 2 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.direct_mapped_blocks, 1 ); 
+  TINYTEST_ASSERT( stats.direct_mapped_bytes >= 100000 ); 
+
+  memset( large, 'x', 100000 );
+
+  // Enough mappings to grow the table, freed out of order
+  for( i = 0; i < 40; i++ ) ptrs[ i ] = ( char * ) mavalloc_alloc ( 40000 );
+  for( i = 0; i < 40; i += 2 ) mavalloc_free( ptrs[ i ] );
+  for( i = 1; i < 40; i += 2 ) mavalloc_free( ptrs[ i ] );
+
+  mavalloc_free( large );
+
+  // If you failed here a mapping was not released on free
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.direct_mapped_blocks, 0 ); 
+  TINYTEST_EQUAL( stats.direct_mapped_bytes, 0 ); 
+
+  mavalloc_set_mmap_threshold( 0 );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 30: Test a reserved arena growing in place
+*
+*/
+int test_case_30()
+{
+  mavalloc_set_reserve( 1 << 20 );
+  mavalloc_init( 4096, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 3000 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 100000 );
+
+  // If you failed here the arena did not grow for the second allocation
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+
+  // If you failed here the arena did not grow contiguously
+  TINYTEST_EQUAL( ptr2 - ptr1, 3000 ); 
+
+  memset( ptr2, 'x', 100000 );
+
+  mavalloc_free( ptr1 );
+  mavalloc_free( ptr2 );
+
+  // If you failed here the grown space did not coalesce with the rest
+  TINYTEST_EQUAL( mavalloc_size(), 1 ); 
+
+  // The reserve is the limit
+  TINYTEST_EQUAL( mavalloc_alloc( 2 << 20 ), NULL ); 
+
+  mavalloc_destroy( );
+
+  mavalloc_init( 4096, BITMAP );
+
+  char * ptr3 = ( char * ) mavalloc_alloc ( 4000 );
+  char * ptr4 = ( char * ) mavalloc_alloc ( 50000 );
+
+  // If you failed here the bitmap did not take over the grown space
+  TINYTEST_ASSERT( ptr3 ); 
+  TINYTEST_ASSERT( ptr4 ); 
+  memset( ptr4, 'x', 50000 );
+
+  mavalloc_destroy( );
+  mavalloc_set_reserve( 0 );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 31: Test trimming the free tail of a reserved arena
+*
+*/
+int test_case_31()
+{
+  struct mavalloc_stats stats;
+
+  mavalloc_set_reserve( 1 << 20 );
+  mavalloc_init( 4096, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 1000 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 200000 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+
+  // Nothing to release while the arena ends with a process node
+  TINYTEST_EQUAL( mavalloc_trim( 0 ), 0 ); 
+
+  mavalloc_free( ptr2 );
+
+  size_t released = mavalloc_trim( 0 );
+
+  // If you failed here the tail hole was not released
+  TINYTEST_ASSERT( released >= 190000 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.trimmed_bytes, released ); 
+
+  // The process node and what is left of the hole
+  TINYTEST_EQUAL( mavalloc_size(), 2 ); 
+
+  char * ptr3 = ( char * ) mavalloc_alloc ( 200000 );
+
+  // If you failed here the arena did not grow back into the released range
+  TINYTEST_EQUAL( ptr2, ptr3 ); 
+  memset( ptr3, 'x', 200000 );
+
+  mavalloc_destroy( );
+  mavalloc_set_reserve( 0 );
+
+  // A malloc backed arena can not be trimmed
+  mavalloc_init( 65535, FIRST_FIT );
+  TINYTEST_EQUAL( mavalloc_trim( 0 ), 0 ); 
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 32: Test switching the heap algorithm at runtime
+*
+*/
+int test_case_32()
+{
+  mavalloc_init( 75000, FIRST_FIT );
+  char * ptr1    = ( char * ) mavalloc_alloc ( 65535 );
+  char * buffer1 = ( char * ) mavalloc_alloc( 1 );
+  char * ptr4    = ( char * ) mavalloc_alloc ( 65 );
+  char * buffer2 = ( char * ) mavalloc_alloc( 1 );
+  char * ptr2    = ( char * ) mavalloc_alloc ( 1500 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr4 ); 
+
+  buffer1 = buffer1;
+  buffer2 = buffer2;
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+
+  // If you failed here the switch between node list algorithms was refused
+  TINYTEST_EQUAL( mavalloc_set_algorithm( BEST_FIT ), 0 ); 
+
+  char * ptr3 = ( char * ) mavalloc_alloc ( 1000 );
+
+  // If you failed here the arena did not use best fit after the switch
+  TINYTEST_EQUAL( ptr2, ptr3 ); 
+  mavalloc_destroy( );
+
+  // BITMAP keeps its own structures and can not switch
+  mavalloc_init( 4096, BITMAP );
+  TINYTEST_EQUAL( mavalloc_set_algorithm( FIRST_FIT ), -1 ); 
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 33: Test ADAPTIVE moving to best fit in a fragmented arena
+*
+*/
+int test_case_33()
+{
+  struct mavalloc_stats stats;
+  char * ptrs[ 60 ];
+  int i;
+
+  mavalloc_init( 20000, ADAPTIVE );
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.active_algorithm, FIRST_FIT ); 
+
+  // Fill the arena with 100 byte blocks separated by 4 byte spacers
+  for( i = 0; i < 60; i++ )
+  {
+    ptrs[ i ] = ( char * ) mavalloc_alloc ( 100 );
+    TINYTEST_ASSERT( mavalloc_alloc( 4 ) ); 
+  }
+  TINYTEST_ASSERT( mavalloc_alloc( 20000 - 60 * 104 ) ); 
+
+  // Leave the free space scattered over many small holes
+  for( i = 0; i < 60; i++ ) mavalloc_free( ptrs[ i ] );
+
+  for( i = 0; i < 300; i++ )
+  {
+    char * ptr = ( char * ) mavalloc_alloc ( 8 );
+    TINYTEST_ASSERT( ptr ); 
+    mavalloc_free( ptr );
+  }
+
+  // If you failed here ADAPTIVE did not react to the fragmentation
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.active_algorithm, BEST_FIT ); 
+  TINYTEST_EQUAL( stats.algorithm_switches, 1 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 34: Test Good Fit bounding the search
+*
+*/
+int test_case_34()
+{
+  struct mavalloc_stats stats;
+
+  mavalloc_init( 4096, GOOD_FIT );
+
+  char * ptr1    = ( char * ) mavalloc_alloc ( 300 );
+  char * buffer1 = ( char * ) mavalloc_alloc( 4 );
+  char * ptr2    = ( char * ) mavalloc_alloc ( 200 );
+  char * buffer2 = ( char * ) mavalloc_alloc( 4 );
+  char * ptr3    = ( char * ) mavalloc_alloc ( 105 );
+  char * buffer3 = ( char * ) mavalloc_alloc( 4 );
+  char * rest    = ( char * ) mavalloc_alloc( 4096 - 628 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+  TINYTEST_ASSERT( rest ); 
+
+  buffer1 = buffer1;
+  buffer2 = buffer2;
+  buffer3 = buffer3;
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+
+  mavalloc_get_stats( &stats );
+  size_t steps = stats.search_steps;
+
+  // Only look at two holes and never stop early
+  mavalloc_set_good_fit( 2, 0 );
+  char * ptr4 = ( char * ) mavalloc_alloc ( 100 );
+
+  // If you failed here the search was not bounded to the first two holes
+  TINYTEST_EQUAL( ptr2, ptr4 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.good_fit_bound_hits, 1 ); 
+
+  // If you failed here the hole that stopped the search was not counted
+  TINYTEST_EQUAL( stats.search_steps, steps + 3 ); 
+
+  mavalloc_free( ptr4 ); 
+
+  // A hole within 10% of the request is taken at once
+  size_t close_fits = stats.good_fit_close_fits;
+  mavalloc_set_good_fit( 8, 10 );
+  char * ptr5 = ( char * ) mavalloc_alloc ( 100 );
+
+  // If you failed here the close fit was not taken
+  TINYTEST_EQUAL( ptr3, ptr5 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.good_fit_close_fits, close_fits + 1 ); 
+
+  mavalloc_set_good_fit( MAVALLOC_GOOD_FIT_CANDIDATES, MAVALLOC_GOOD_FIT_SLACK );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 35: Test the Cartesian tree hole index
+*
+*/
+int test_case_35()
+{
+  mavalloc_set_hole_index( HOLE_INDEX_CARTESIAN );
+  mavalloc_init( 4096, FIRST_FIT );
+
+  char * ptr1    = ( char * ) mavalloc_alloc ( 300 );
+  char * buffer1 = ( char * ) mavalloc_alloc( 4 );
+  char * ptr2    = ( char * ) mavalloc_alloc ( 200 );
+  char * buffer2 = ( char * ) mavalloc_alloc( 4 );
+  char * ptr3    = ( char * ) mavalloc_alloc ( 100 );
+  char * buffer3 = ( char * ) mavalloc_alloc( 4 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  buffer1 = buffer1;
+  buffer2 = buffer2;
+  buffer3 = buffer3;
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+
+  // First fit takes the lowest hole that fits
+  char * ptr4 = ( char * ) mavalloc_alloc ( 150 );
+
+  // If you failed here the tree did not find the lowest fitting hole
+  TINYTEST_EQUAL( ptr1, ptr4 ); 
+
+  mavalloc_free( ptr4 ); 
+
+  // Best fit takes the smallest hole that fits
+  mavalloc_set_algorithm( BEST_FIT );
+  char * ptr5 = ( char * ) mavalloc_alloc ( 150 );
+
+  // If you failed here the tree did not find the smallest fitting hole
+  TINYTEST_EQUAL( ptr2, ptr5 ); 
+
+  // Worst fit takes the largest hole, the rest of the arena
+  mavalloc_set_algorithm( WORST_FIT );
+  char * ptr6 = ( char * ) mavalloc_alloc ( 150 );
+
+  // If you failed here the tree root was not the largest hole
+  TINYTEST_ASSERT( ptr6 > buffer3 ); 
+
+  // Freeing everything merges the holes back into one
+  mavalloc_free( ptr5 ); 
+  mavalloc_free( ptr6 ); 
+  mavalloc_free( buffer1 ); 
+  mavalloc_free( buffer2 ); 
+  mavalloc_free( buffer3 ); 
+
+  // If you failed here the freed holes were not combined
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  char * ptr7 = ( char * ) mavalloc_alloc ( 4096 );
+
+  // If you failed here the combined hole was not indexed
+  TINYTEST_EQUAL( ptr1, ptr7 ); 
+
+  mavalloc_destroy( );
+  mavalloc_set_hole_index( HOLE_INDEX_LIST );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 36: Test lifetime hints placing long lived blocks at the top
+*
+*/
+int test_case_36()
+{
+  struct mavalloc_stats stats;
+
+  mavalloc_init( 4096, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc_hint ( 100, MAVALLOC_HINT_SHORT );
+  char * ptr2 = ( char * ) mavalloc_alloc_hint ( 96, MAVALLOC_HINT_LONG );
+  char * ptr3 = ( char * ) mavalloc_alloc_hint ( 100, MAVALLOC_HINT_SHORT );
+  char * ptr4 = ( char * ) mavalloc_alloc_hint ( 200, MAVALLOC_HINT_PERMANENT );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+  TINYTEST_ASSERT( ptr4 ); 
+
+  // If you failed here the short lived blocks were not packed from the start
+  TINYTEST_EQUAL( ptr3, ptr1 + 100 ); 
+
+  // If you failed here the long lived block was not placed at the end
+  TINYTEST_EQUAL( ptr2 + 96, ptr1 + 4096 ); 
+
+  // If you failed here the next long lived block was not placed below it
+  TINYTEST_EQUAL( ptr4 + 200, ptr2 ); 
+
+  // Freeing the short lived blocks leaves one hole, not holes pinned 
+  // between long lived blocks
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr3 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.short_allocations, 2 ); 
+  TINYTEST_EQUAL( stats.long_allocations, 1 ); 
+  TINYTEST_EQUAL( stats.permanent_allocations, 1 ); 
+
+  // If you failed here the free space was split up
+  TINYTEST_EQUAL( stats.free_holes, 1 ); 
+  TINYTEST_EQUAL( stats.free_bytes, 4096 - 296 ); 
+  TINYTEST_EQUAL( stats.largest_hole, 4096 - 296 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 37: Test allocating close to an existing block
+*
+*/
+int test_case_37()
+{
+  struct mavalloc_stats stats;
+
+  mavalloc_init( 4096, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr4 = ( char * ) mavalloc_alloc ( 100 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr4 ); 
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr3 ); 
+
+  // The hole of ptr3 is right below ptr4, so the block takes its top
+  char * ptr5 = ( char * ) mavalloc_alloc_near ( ptr4, 40 );
+
+  // If you failed here the block was not placed next to the hint
+  TINYTEST_EQUAL( ptr5, ptr4 - 40 ); 
+
+  // The hole of ptr1 touches ptr2 while the rest of ptr3 is further away
+  char * ptr6 = ( char * ) mavalloc_alloc_near ( ptr2, 20 );
+
+  // If you failed here the nearest hole was not chosen
+  TINYTEST_EQUAL( ptr6, ptr2 - 20 ); 
+
+  // The hole after ptr4 is the only one that fits and starts at its end
+  char * ptr7 = ( char * ) mavalloc_alloc_near ( ptr2, 200 );
+
+  // If you failed here the block was not carved from the start of the hole
+  TINYTEST_EQUAL( ptr7, ptr4 + 100 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.near_allocations, 3 ); 
+  TINYTEST_EQUAL( stats.near_distance_bytes, 300 ); 
+
+  // Without a hint the heap algorithm places the block
+  char * ptr8 = ( char * ) mavalloc_alloc_near ( NULL, 20 );
+
+  // If you failed here first fit did not take the lowest hole
+  TINYTEST_EQUAL( ptr8, ptr1 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 38: Test cache coloring of large blocks
+*
+*/
+int test_case_38()
+{
+  struct mavalloc_stats stats;
+
+  TINYTEST_EQUAL( mavalloc_set_coloring( 64, 0 ), -1 ); 
+  TINYTEST_EQUAL( mavalloc_set_coloring( 64, 4 ), 0 ); 
+  TINYTEST_EQUAL( mavalloc_get_color_stride( ), 64 ); 
+
+  mavalloc_init( 65536, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 4096 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 4096 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 4096 );
+  char * ptr4 = ( char * ) mavalloc_alloc ( 200 );
+
+  // If you failed here the first color was not offset 0
+  TINYTEST_EQUAL( ptr1, ( char * ) ptr4 - 3 * 4096 - 64 - 128 ); 
+
+  // If you failed here successive large blocks did not rotate colors
+  TINYTEST_EQUAL( ptr2, ptr1 + 4096 + 64 ); 
+  TINYTEST_EQUAL( ptr3, ptr2 + 4096 + 128 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.colored_allocations, 2 ); 
+  TINYTEST_EQUAL( stats.color_offset_bytes, 192 ); 
+
+  // Freeing the blocks merges the offsets back into the free space
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+  mavalloc_free( ptr4 ); 
+
+  // If you failed here the offset holes were not combined
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  mavalloc_destroy( );
+  mavalloc_init( 8224, FIRST_FIT );
+
+  ptr1 = ( char * ) mavalloc_alloc ( 4096 );
+  ptr2 = ( char * ) mavalloc_alloc ( 4096 );
+
+  // If you failed here a hole too small for the offset was colored
+  TINYTEST_EQUAL( ptr2, ptr1 + 4096 ); 
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+
+  // If you failed here the skipped color was not kept for the next block
+  ptr1 = ( char * ) mavalloc_alloc ( 4096 );
+  TINYTEST_EQUAL( ptr1, ptr2 - 4096 + 64 ); 
+  mavalloc_free( ptr1 ); 
+
+  mavalloc_destroy( );
+  mavalloc_init( 65536, FIRST_FIT );
+  mavalloc_set_split_threshold( 100 );
+
+  ptr1 = ( char * ) mavalloc_alloc ( 4096 );
+  ptr2 = ( char * ) mavalloc_alloc ( 4096 );
+  ptr3 = ( char * ) mavalloc_alloc ( 4096 );
+
+  // If you failed here an offset below the split threshold left a sliver hole
+  TINYTEST_EQUAL( ptr2, ptr1 + 4096 ); 
+  TINYTEST_EQUAL( ptr3, ptr2 + 4096 + 128 ); 
+  TINYTEST_EQUAL( mavalloc_size( ), 5 ); 
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+
+  mavalloc_set_split_threshold( 0 );
+  mavalloc_set_coloring( 0, 0 );
+  TINYTEST_EQUAL( mavalloc_get_color_stride( ), 0 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 39: Test cache line aligned blocks
+*
+*/
+int test_case_39()
+{
+  struct mavalloc_stats stats;
+
+  mavalloc_init( 4096, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 12 );
+  char * ptr2 = ( char * ) mavalloc_alloc_hint ( 12, MAVALLOC_HINT_CACHE_ALIGN );
+  char * ptr3 = ( char * ) mavalloc_alloc_hint ( 12, MAVALLOC_HINT_CACHE_ALIGN );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  // If you failed here the block was not moved to a cache line boundary
+  TINYTEST_EQUAL( ( ( uintptr_t ) ptr2 ) % MAVALLOC_CACHE_LINE, 0 ); 
+
+  // If you failed here the block was not a whole cache line long
+  TINYTEST_EQUAL( ptr3, ptr2 + MAVALLOC_CACHE_LINE ); 
+
+  // The padding in front of ptr2 was released as a hole
+  char * ptr4 = ( char * ) mavalloc_alloc ( 12 );
+
+  // If you failed here the padding was not given back
+  TINYTEST_EQUAL( ptr4, ptr1 + 12 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.aligned_pad_bytes, MAVALLOC_CACHE_LINE - 12 ); 
+
+  mavalloc_destroy( );
+
+  // Aligning the whole arena puts every block on its own lines
+  mavalloc_set_cache_align( 1 );
+  mavalloc_init( 4096, BEST_FIT );
+
+  char * ptr5 = ( char * ) mavalloc_alloc ( 4 );
+  char * ptr6 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr7 = ( char * ) mavalloc_alloc ( 4 );
+
+  // If you failed here the blocks were not rounded to whole cache lines
+  TINYTEST_EQUAL( ( ( uintptr_t ) ptr5 ) % MAVALLOC_CACHE_LINE, 0 ); 
+  TINYTEST_EQUAL( ptr6, ptr5 + MAVALLOC_CACHE_LINE ); 
+  TINYTEST_EQUAL( ptr7, ptr6 + 2 * MAVALLOC_CACHE_LINE ); 
+
+  mavalloc_get_stats( &stats );
+
+  // If you failed here an aligned arena needed padding
+  TINYTEST_EQUAL( stats.aligned_pad_bytes, 0 ); 
+
+  mavalloc_set_cache_align( 0 );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 40: Test child arenas carved from the main arena
+*
+*/
+int test_case_40()
+{
+  mavalloc_init( 65536, BEST_FIT );
+
+  struct mavalloc_arena * bump = mavalloc_arena_create_from( NULL, 1024, ARENA_BUMP );
+
+  // If you failed here the child arena was not carved from the main arena
+  TINYTEST_ASSERT( bump ); 
+  TINYTEST_EQUAL( mavalloc_size( ), 2 ); 
+
+  char * ptr1 = ( char * ) mavalloc_arena_alloc( bump, 10 );
+  char * ptr2 = ( char * ) mavalloc_arena_alloc( bump, 10 );
+
+  // If you failed here the bump pointer did not move by aligned sizes
+  TINYTEST_EQUAL( ptr2, ptr1 + 16 ); 
+
+  size_t mark = mavalloc_arena_mark( bump );
+  char * ptr3 = ( char * ) mavalloc_arena_alloc( bump, 1000 );
+
+  // If you failed here the child arena handed out more than it has
+  TINYTEST_EQUAL( ptr3, NULL ); 
+
+  ptr3 = ( char * ) mavalloc_arena_alloc( bump, 100 );
+  mavalloc_arena_reset( bump, mark );
+  char * ptr4 = ( char * ) mavalloc_arena_alloc( bump, 8 );
+
+  // If you failed here the reset did not return to the mark
+  TINYTEST_EQUAL( ptr3, ptr4 ); 
+
+  // A stack arena nested inside the bump arena
+  struct mavalloc_arena * stack = mavalloc_arena_create_from( bump, 512, ARENA_STACK );
+  TINYTEST_ASSERT( stack ); 
+
+  char * ptr5 = ( char * ) mavalloc_arena_alloc( stack, 32 );
+  char * ptr6 = ( char * ) mavalloc_arena_alloc( stack, 32 );
+  char * ptr7 = ( char * ) mavalloc_arena_alloc( stack, 32 );
+
+  TINYTEST_ASSERT( ptr5 ); 
+
+  // Freeing below the top waits for the blocks above
+  mavalloc_arena_free( stack, ptr6 ); 
+  char * ptr8 = ( char * ) mavalloc_arena_alloc( stack, 32 );
+
+  // If you failed here a block under the top was reused
+  TINYTEST_EQUAL( ptr8, ptr7 + 40 ); 
+
+  // Freeing the top pops the freed blocks under it too
+  mavalloc_arena_free( stack, ptr8 ); 
+  mavalloc_arena_free( stack, ptr7 ); 
+  char * ptr9 = ( char * ) mavalloc_arena_alloc( stack, 32 );
+
+  // If you failed here the stack did not pop down to ptr6
+  TINYTEST_EQUAL( ptr9, ptr6 ); 
+
+  mavalloc_arena_destroy( stack );
+
+  // The whole child goes back to the main arena in one free
+  mavalloc_arena_destroy( bump );
+
+  // If you failed here the child arena was not freed
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 41: Test rolling back transactions
+*
+*/
+int test_case_41()
+{
+  struct mavalloc_txn outer;
+  struct mavalloc_txn inner;
+
+  mavalloc_set_mmap_threshold( 8192 );
+  mavalloc_init( 4096, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 100 );
+
+  mavalloc_txn_begin( &outer );
+
+  char * ptr2 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr4 = ( char * ) mavalloc_alloc ( 10000 );
+
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr4 ); 
+
+  mavalloc_free( ptr3 ); 
+
+  mavalloc_txn_begin( &inner );
+  char * ptr5 = ( char * ) mavalloc_alloc ( 200 );
+  mavalloc_txn_commit( &inner );
+
+  TINYTEST_ASSERT( ptr5 ); 
+
+  // ptr2, the mapping of ptr4 and the committed ptr5 are freed. ptr3 
+  // was already freed
+  // If you failed here the wrong blocks were rolled back
+  TINYTEST_EQUAL( mavalloc_txn_rollback( &outer ), 3 ); 
+
+  // If you failed here the freed blocks were not combined
+  TINYTEST_EQUAL( mavalloc_size( ), 2 ); 
+
+  char * ptr6 = ( char * ) mavalloc_alloc ( 100 );
+
+  // If you failed here ptr1 was rolled back or ptr2 was not
+  TINYTEST_EQUAL( ptr6, ptr2 ); 
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr6 ); 
+  mavalloc_destroy( );
+  mavalloc_set_mmap_threshold( 0 );
+
+  // RING moves its tail back
+  mavalloc_init( 4096, RING );
+
+  ptr1 = ( char * ) mavalloc_alloc ( 100 );
+
+  mavalloc_txn_begin( &outer );
+  ptr2 = ( char * ) mavalloc_alloc ( 100 );
+  ptr3 = ( char * ) mavalloc_alloc ( 100 );
+
+  TINYTEST_EQUAL( mavalloc_txn_rollback( &outer ), 2 ); 
+
+  // If you failed here the tail did not move back
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+  TINYTEST_EQUAL( ( char * ) mavalloc_alloc ( 100 ), ptr2 ); 
+
+  mavalloc_destroy( );
+
+  // BITMAP frees the blocks it recorded
+  mavalloc_init( 4096, BITMAP );
+
+  ptr1 = ( char * ) mavalloc_alloc ( 100 );
+
+  mavalloc_txn_begin( &outer );
+  ptr2 = ( char * ) mavalloc_alloc ( 100 );
+  mavalloc_free( ptr2 ); 
+  ptr3 = ( char * ) mavalloc_alloc ( 200 );
+
+  // If you failed here a block was freed twice or not at all
+  TINYTEST_EQUAL( mavalloc_txn_rollback( &outer ), 1 ); 
+  TINYTEST_EQUAL( mavalloc_size( ), 2 ); 
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 42: Test batched frees and epoch based reclamation
+*
+*/
+int test_case_42()
+{
+  struct mavalloc_stats stats;
+  void * ptrs[ 4 ];
+  int i;
+
+  mavalloc_init( 4096, FIRST_FIT );
+
+  for( i = 0; i < 4; i++ ) ptrs[ i ] = mavalloc_alloc( 64 );
+
+  char * keep = ( char * ) mavalloc_alloc ( 64 );
+
+  // Free out of order in one batch
+  void * batch[ 3 ] = { ptrs[ 3 ], ptrs[ 0 ], ptrs[ 1 ] };
+  mavalloc_free_batch( batch, 3 );
+
+  // If you failed here the batch was not freed and coalesced
+  TINYTEST_EQUAL( mavalloc_size( ), 5 ); 
+
+  mavalloc_free( ptrs[ 2 ] ); 
+  mavalloc_free( keep ); 
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  int reader = mavalloc_epoch_register( );
+  TINYTEST_ASSERT( reader >= 0 ); 
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 64 );
+
+  // A reader inside a critical section holds back reclamation
+  mavalloc_epoch_enter( reader );
+  mavalloc_retire( ptr1 );
+  mavalloc_epoch_reclaim( );
+  mavalloc_epoch_reclaim( );
+
+  // If you failed here a block was freed while a reader could see it
+  TINYTEST_EQUAL( mavalloc_size( ), 2 ); 
+
+  mavalloc_epoch_exit( reader );
+
+  // Two epochs later nobody can still see the block
+  mavalloc_epoch_reclaim( );
+  mavalloc_epoch_reclaim( );
+
+  // If you failed here the retired block was not freed
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.reclaimed_blocks, 1 ); 
+
+  // A block retired inside a transaction is left to reclaiming
+  struct mavalloc_txn txn;
+
+  mavalloc_txn_begin( &txn );
+  ptr1 = ( char * ) mavalloc_alloc ( 64 );
+  mavalloc_retire( ptr1 );
+
+  // If you failed here the rollback freed a retired block
+  TINYTEST_EQUAL( mavalloc_txn_rollback( &txn ), 0 ); 
+
+  char * ptr2 = ( char * ) mavalloc_alloc ( 64 );
+  TINYTEST_ASSERT( ptr2 != ptr1 ); 
+
+  mavalloc_epoch_reclaim( );
+  mavalloc_epoch_reclaim( );
+
+  // If you failed here reclaiming freed a block that is in use
+  char * ptr3 = ( char * ) mavalloc_alloc ( 64 );
+  TINYTEST_ASSERT( ptr3 != ptr2 ); 
+
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  mavalloc_epoch_unregister( reader );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 43: Test the background maintenance thread
+*
+*/
+int test_case_43()
+{
+  struct mavalloc_stats stats;
+  int i;
+
+  mavalloc_set_reserve( 4 * 1024 * 1024 );
+  mavalloc_init( 1024 * 1024, FIRST_FIT );
+  mavalloc_quickfit( 1, 4 );
+  mavalloc_quickfit_size( 256 );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 256 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 256 * 1024 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 256 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  memset( ptr2, 1, 256 * 1024 );
+
+  // ptr1 is cached on its quick-fit list, ptr2 leaves a large hole
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+
+  TINYTEST_EQUAL( mavalloc_maintenance_start( 5, 1024 * 1024 ), 0 ); 
+
+  // If you failed here a second thread was started
+  TINYTEST_EQUAL( mavalloc_maintenance_start( 5, 1024 * 1024 ), -1 ); 
+
+  // Wait for a few passes, the tail is only trimmed once it stayed idle
+  for( i = 0; i < 200; i++ )
+  {
+    mavalloc_get_stats( &stats );
+    if( stats.maintenance_passes >= 3 ) break;
+    usleep( 5000 );
+  }
+
+  mavalloc_maintenance_stop( );
+  mavalloc_get_stats( &stats );
+
+  // If you failed here the thread did not run
+  TINYTEST_ASSERT( stats.maintenance_passes >= 3 ); 
+
+  // If you failed here the unused cached block was not coalesced
+  TINYTEST_EQUAL( stats.maintenance_flushes, 1 ); 
+
+  // If you failed here the pages of the large hole were not purged
+  TINYTEST_ASSERT( stats.purged_bytes > 0 ); 
+
+  // If you failed here the tail was not trimmed
+  TINYTEST_ASSERT( stats.trimmed_bytes > 0 ); 
+
+  // If you failed here the trim did not keep a growth step of slack
+  TINYTEST_ASSERT( stats.trimmed_bytes <= 1024 * 1024 - 256 * 1024 - 512 - 1024 * 1024 / 8 ); 
+
+  // The purged hole is still usable
+  char * ptr4 = ( char * ) mavalloc_alloc ( 256 * 1024 );
+  TINYTEST_EQUAL( ptr4, ptr1 ); 
+  memset( ptr4, 2, 256 * 1024 );
+
+  mavalloc_set_thread_safe( 0 );
+  mavalloc_quickfit( 0, 0 );
+  mavalloc_destroy( );
+  mavalloc_set_reserve( 0 );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 44: Test the memory limits and the pressure callback
+*
+*/
+int pressure_calls;
+enum MAVALLOC_PRESSURE pressure_level;
+void * pressure_cache;
+
+void pressure_evict( enum MAVALLOC_PRESSURE level, size_t used_bytes, size_t request, void * context )
+{
+  pressure_calls++;
+  pressure_level = level;
+
+  // Evict the cached block when the hard limit is in the way
+  if( level == MAVALLOC_PRESSURE_HARD && pressure_cache != NULL )
+  {
+    mavalloc_free( pressure_cache );
+    pressure_cache = NULL;
+  }
+}
+
+int test_case_44()
+{
+  struct mavalloc_stats stats;
+
+  pressure_calls = 0;
+  pressure_cache = NULL;
+
+  mavalloc_init( 65536, FIRST_FIT );
+
+  // If you failed here a soft limit above the hard limit was accepted
+  TINYTEST_EQUAL( mavalloc_set_limits( 3000, 2000 ), -1 ); 
+
+  TINYTEST_EQUAL( mavalloc_set_limits( 1000, 2000 ), 0 ); 
+  mavalloc_set_pressure_callback( pressure_evict, NULL );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 800 );
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 800 ); 
+  TINYTEST_EQUAL( pressure_calls, 0 ); 
+
+  // If you failed here crossing the soft limit was not reported
+  pressure_cache = mavalloc_alloc ( 400 );
+  TINYTEST_ASSERT( pressure_cache ); 
+  TINYTEST_EQUAL( pressure_calls, 1 ); 
+  TINYTEST_EQUAL( pressure_level, MAVALLOC_PRESSURE_SOFT ); 
+
+  // If you failed here the soft limit was reported twice
+  char * ptr2 = ( char * ) mavalloc_alloc ( 100 );
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_EQUAL( pressure_calls, 1 ); 
+
+  // The callback evicts the cached block to make room under the hard limit
+  char * ptr3 = ( char * ) mavalloc_alloc ( 1000 );
+  TINYTEST_ASSERT( ptr3 ); 
+  TINYTEST_EQUAL( pressure_calls, 2 ); 
+  TINYTEST_EQUAL( pressure_level, MAVALLOC_PRESSURE_HARD ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 1900 ); 
+
+  // If you failed here the hard limit let the arena go past it
+  char * ptr4 = ( char * ) mavalloc_alloc ( 1500 );
+  TINYTEST_EQUAL( ptr4, NULL ); 
+  TINYTEST_EQUAL( pressure_calls, 3 ); 
+
+  // Falling back under the soft limit arms the callback again
+  mavalloc_free( ptr3 ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 900 ); 
+
+  ptr3 = ( char * ) mavalloc_alloc ( 200 );
+  TINYTEST_ASSERT( ptr3 ); 
+  TINYTEST_EQUAL( pressure_calls, 4 ); 
+  TINYTEST_EQUAL( pressure_level, MAVALLOC_PRESSURE_SOFT ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.limit_failures, 1 ); 
+  TINYTEST_EQUAL( stats.pressure_callbacks, 4 ); 
+  TINYTEST_EQUAL( stats.used_bytes, 1100 ); 
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+
+  // If you failed here freed bytes were not taken off the count
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 ); 
+
+  mavalloc_set_limits( 0, 0 );
+  mavalloc_set_pressure_callback( NULL, NULL );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 45: Test allocations on an alignment boundary
+*
+*/
+int test_case_45()
+{
+  mavalloc_init( 65536, FIRST_FIT );
+
+  char * ptr1 = ( char * ) mavalloc_alloc ( 100 );
+  char * ptr2 = ( char * ) mavalloc_alloc_aligned ( 300, 256 );
+  char * ptr3 = ( char * ) mavalloc_alloc_aligned ( 40, 4096 );
+
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+
+  // If you failed here the blocks are not on their boundaries
+  TINYTEST_EQUAL( ( uintptr_t ) ptr2 % 256, 0 ); 
+  TINYTEST_EQUAL( ( uintptr_t ) ptr3 % 4096, 0 ); 
+
+  // If you failed here an alignment that is not a power of two was accepted
+  TINYTEST_EQUAL( mavalloc_alloc_aligned( 64, 48 ), NULL ); 
+
+  memset( ptr2, 1, 300 );
+  memset( ptr3, 2, 40 );
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+
+  // If you failed here the bytes around the aligned blocks were lost
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  // Child arenas pad to the boundary, and a stack gives the padding 
+  // back with the block
+  struct mavalloc_arena * arena = mavalloc_arena_create_from( NULL, 4096, ARENA_STACK );
+  TINYTEST_ASSERT( arena ); 
+
+  char * ptr4 = ( char * ) mavalloc_arena_alloc ( arena, 24 );
+  char * ptr5 = ( char * ) mavalloc_arena_alloc_aligned ( arena, 100, 512 );
+
+  TINYTEST_ASSERT( ptr4 ); 
+  TINYTEST_ASSERT( ptr5 ); 
+  TINYTEST_EQUAL( ( uintptr_t ) ptr5 % 512, 0 ); 
+
+  mavalloc_arena_free( arena, ptr5 ); 
+  TINYTEST_EQUAL( mavalloc_arena_mark( arena ), 32 ); 
+
+  mavalloc_arena_free( arena, ptr4 ); 
+  TINYTEST_EQUAL( mavalloc_arena_mark( arena ), 0 ); 
+
+  mavalloc_arena_destroy( arena );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 46: Test the I/O buffer pool with io_uring and the fallback
+*
+*/
+int test_case_46()
+{
+  char path[ ] = "/tmp/mavalloc_io_XXXXXX";
+  size_t page = sysconf( _SC_PAGESIZE );
+  int flags;
+
+  mavalloc_init( 1024 * 1024, FIRST_FIT );
+
+  int fd = mkstemp( path );
+  TINYTEST_ASSERT( fd >= 0 ); 
+  unlink( path );
+
+  for( flags = 0; flags <= MAVALLOC_IO_FALLBACK; flags++ )
+  {
+    struct mavalloc_io_buffer buffer1;
+    struct mavalloc_io_buffer buffer2;
+    struct mavalloc_io_buffer buffer3;
+
+    struct mavalloc_io_pool * pool = mavalloc_io_pool_create( 5000, 2, flags );
+    TINYTEST_ASSERT( pool ); 
+
+    // If you failed here the fallback pool registered its buffers
+    if( flags & MAVALLOC_IO_FALLBACK ) TINYTEST_EQUAL( mavalloc_io_pool_fixed( pool ), 0 );
+
+    TINYTEST_EQUAL( mavalloc_io_pool_get( pool, &buffer1 ), 0 ); 
+    TINYTEST_EQUAL( mavalloc_io_pool_get( pool, &buffer2 ), 0 ); 
+
+    // If you failed here the pool handed out more buffers than it has
+    TINYTEST_EQUAL( mavalloc_io_pool_get( pool, &buffer3 ), -1 ); 
+
+    // If you failed here the buffers are not whole aligned pages
+    TINYTEST_EQUAL( ( uintptr_t ) buffer1.data % page, 0 ); 
+    TINYTEST_EQUAL( ( uintptr_t ) buffer2.data % page, 0 ); 
+    TINYTEST_EQUAL( buffer1.size, ( ( 5000 + page - 1 ) / page ) * page ); 
+    TINYTEST_EQUAL( buffer1.index, 0 ); 
+    TINYTEST_EQUAL( buffer2.index, 1 ); 
+
+    memset( buffer1.data, 'a' + flags, 5000 );
+
+    TINYTEST_EQUAL( mavalloc_io_write( pool, fd, &buffer1, 5000, 100 ), 5000 ); 
+    TINYTEST_EQUAL( mavalloc_io_read( pool, fd, &buffer2, 5000, 100 ), 5000 ); 
+
+    // If you failed here the data did not make the round trip
+    TINYTEST_EQUAL( memcmp( buffer1.data, buffer2.data, 5000 ), 0 ); 
+
+    // If you failed here a read past the end of the buffer was accepted
+    TINYTEST_EQUAL( mavalloc_io_read( pool, fd, &buffer2, buffer2.size + 1, 0 ), -1 ); 
+
+    // If you failed here a read from a closed file did not fail
+    TINYTEST_EQUAL( mavalloc_io_read( pool, -1, &buffer2, 100, 0 ), -1 ); 
+    TINYTEST_EQUAL( errno, EBADF ); 
+
+    mavalloc_io_pool_put( pool, &buffer1 );
+    TINYTEST_EQUAL( mavalloc_io_pool_get( pool, &buffer3 ), 0 ); 
+    TINYTEST_EQUAL( buffer3.index, 0 ); 
+
+    mavalloc_io_pool_destroy( pool );
+  }
+
+  struct mavalloc_stats stats;
+  mavalloc_get_stats( &stats );
+
+  // If you failed here the reads and writes were not counted, or 
+  // failed ones were
+  TINYTEST_EQUAL( stats.io_fixed_ops + stats.io_fallback_ops, 4 ); 
+  TINYTEST_ASSERT( stats.io_fallback_ops >= 2 ); 
+
+  // If you failed here the pools did not give their buffers back
+  TINYTEST_EQUAL( mavalloc_size( ), 1 ); 
+
+  close( fd );
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 47: Test the hard limit against the bytes a block is charged
+*
+*/
+int test_case_47()
+{
+  struct mavalloc_stats stats;
+
+  pressure_calls = 0;
+  pressure_cache = NULL;
+
+  mavalloc_init( 65536, FIRST_FIT );
+  mavalloc_set_limits( 0, 5500 );
+
+  // A direct mapping is charged its page rounded length
+  mavalloc_set_mmap_threshold( 4096 );
+
+  // If you failed here the mapping went past the hard limit
+  char * ptr1 = ( char * ) mavalloc_alloc ( 4100 );
+  TINYTEST_EQUAL( ptr1, NULL ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 ); 
+
+  mavalloc_set_mmap_threshold( 0 );
+
+  // A hole that is too small to split is charged whole
+  mavalloc_set_limits( 0, 0 );
+  mavalloc_set_split_threshold( 2048 );
+
+  ptr1 = ( char * ) mavalloc_alloc ( 1000 );
+  char * ptr2 = ( char * ) mavalloc_alloc ( 3000 );
+  char * ptr3 = ( char * ) mavalloc_alloc ( 1000 );
+  pressure_cache = mavalloc_alloc ( 1000 );
+  TINYTEST_ASSERT( ptr1 ); 
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_ASSERT( ptr3 ); 
+  TINYTEST_ASSERT( pressure_cache ); 
+
+  mavalloc_free( ptr2 ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 3000 ); 
+  mavalloc_set_limits( 0, 5500 );
+
+  // If you failed here the whole hole was charged past the hard limit
+  ptr2 = ( char * ) mavalloc_alloc ( 1000 );
+  TINYTEST_EQUAL( ptr2, NULL ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 3000 ); 
+  TINYTEST_EQUAL( mavalloc_size( ), 5 ); 
+
+  // The callback evicts the cached block, which leaves room for the hole
+  mavalloc_set_pressure_callback( pressure_evict, NULL );
+
+  ptr2 = ( char * ) mavalloc_alloc ( 1000 );
+  TINYTEST_ASSERT( ptr2 ); 
+  TINYTEST_EQUAL( pressure_calls, 1 ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 5000 ); 
+
+  mavalloc_get_stats( &stats );
+  TINYTEST_EQUAL( stats.limit_failures, 2 ); 
+
+  mavalloc_free( ptr1 ); 
+  mavalloc_free( ptr2 ); 
+  mavalloc_free( ptr3 ); 
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 ); 
+
+  mavalloc_set_split_threshold( 0 );
+  mavalloc_set_limits( 0, 0 );
+  mavalloc_set_pressure_callback( NULL, NULL );
+  mavalloc_destroy( );
+  return 1;
+}
+
 int tinytest_setup(const char *pName)
 {
     fprintf( stderr, "tinytest_setup(%s)\n", pName);
@@ -674,6 +2216,33 @@ TINYTEST_START_SUITE(MavAllocTestSuite);
   TINYTEST_ADD_TEST(test_case_18,tinytest_setup,tinytest_teardown);
   TINYTEST_ADD_TEST(test_case_19,tinytest_setup,tinytest_teardown);
   TINYTEST_ADD_TEST(test_case_20,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_21,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_22,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_23,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_24,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_25,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_26,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_27,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_28,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_29,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_30,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_31,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_32,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_33,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_34,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_35,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_36,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_37,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_38,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_39,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_40,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_41,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_42,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_43,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_44,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_45,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_46,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_47,tinytest_setup,tinytest_teardown);
 TINYTEST_END_SUITE();
 
 TINYTEST_MAIN_SINGLE_SUITE(MavAllocTestSuite);
@@ -0,0 +1,414 @@
+#include "mavalloc.hpp"
+#include "tinytest.h"
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <map>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+/*
+*
+* TEST CASE 1: Test a pmr vector on the main arena
+*
+*/
+int test_case_1( const char * pName )
+{
+  mavalloc_init( 65536, FIRST_FIT );
+
+  {
+    mavalloc::arena_resource resource;
+    std::pmr::vector< int > numbers( &resource );
+    int i;
+
+    for( i = 0; i < 1000; i++ ) numbers.push_back( i );
+
+    // If you failed here the vector lost its elements while growing
+    TINYTEST_EQUAL( numbers[ 999 ], 999 );
+
+    // If you failed here the vector did not come from the arena
+    TINYTEST_ASSERT( mavalloc_used_bytes( ) >= 1000 * sizeof( int ) );
+
+    // If you failed here two resources on the main arena compare unequal
+    mavalloc::arena_resource other;
+    TINYTEST_ASSERT( resource == other );
+  }
+
+  // If you failed here the vector did not give its blocks back
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 );
+  TINYTEST_EQUAL( mavalloc_size( ), 1 );
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 2: Test the alignment argument of the memory resource
+*
+*/
+int test_case_2( const char * pName )
+{
+  mavalloc_init( 65536, BEST_FIT );
+
+  mavalloc::arena_resource resource;
+
+  void * ptr1 = resource.allocate( 100, 128 );
+  void * ptr2 = resource.allocate( 10, 1024 );
+
+  // If you failed here the alignment argument was ignored
+  TINYTEST_EQUAL( ( std::uintptr_t ) ptr1 % 128, 0 );
+  TINYTEST_EQUAL( ( std::uintptr_t ) ptr2 % 1024, 0 );
+
+  resource.deallocate( ptr1, 100, 128 );
+  resource.deallocate( ptr2, 10, 1024 );
+
+  // If you failed here a full arena did not throw std::bad_alloc
+  int thrown = 0;
+
+  try
+  {
+    TINYTEST_EQUAL( resource.allocate( 1 << 20, 8 ), nullptr );
+  }
+  catch( const std::bad_alloc & )
+  {
+    thrown = 1;
+  }
+
+  TINYTEST_EQUAL( thrown, 1 );
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 3: Test a monotonic scope for one request
+*
+*/
+int test_case_3( const char * pName )
+{
+  mavalloc_init( 65536, FIRST_FIT );
+
+  {
+    mavalloc::monotonic_scope scope( 16384 );
+
+    // If you failed here the scope did not take its block from the arena
+    TINYTEST_EQUAL( mavalloc_size( ), 2 );
+
+    size_t used = mavalloc_used_bytes( );
+
+    std::pmr::vector< std::pmr::string > words( &scope );
+    int i;
+
+    for( i = 0; i < 20; i++ ) words.emplace_back( "a string too long for the small buffer" );
+
+    TINYTEST_EQUAL( words.size( ), 20 );
+
+    // If you failed here the strings used the main arena
+    TINYTEST_EQUAL( mavalloc_used_bytes( ), used );
+
+    void * ptr = scope.allocate( 8, 64 );
+    TINYTEST_EQUAL( ( std::uintptr_t ) ptr % 64, 0 );
+
+    // If you failed here the scope was not equal to itself only
+    mavalloc::monotonic_scope other( 1024 );
+    TINYTEST_ASSERT( scope == scope );
+    TINYTEST_ASSERT( !( scope == other ) );
+  }
+
+  // If you failed here the scope did not give its block back
+  TINYTEST_EQUAL( mavalloc_size( ), 1 );
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 );
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 4: Test releasing a monotonic scope
+*
+*/
+int test_case_4( const char * pName )
+{
+  mavalloc_init( 65536, FIRST_FIT );
+
+  {
+    mavalloc::monotonic_scope scope( 1024 );
+
+    void * ptr1 = scope.allocate( 1000, 8 );
+    TINYTEST_ASSERT( ptr1 );
+
+    // If you failed here a full scope did not throw std::bad_alloc
+    int thrown = 0;
+
+    try
+    {
+      TINYTEST_EQUAL( scope.allocate( 100, 8 ), nullptr );
+    }
+    catch( const std::bad_alloc & )
+    {
+      thrown = 1;
+    }
+
+    TINYTEST_EQUAL( thrown, 1 );
+
+    // If you failed here release did not start the scope over
+    scope.release( );
+
+    void * ptr2 = scope.allocate( 1000, 8 );
+    TINYTEST_EQUAL( ptr2, ptr1 );
+  }
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 5: Test an object pool sized at compile time
+*
+*/
+int pool_objects;
+
+struct alignas( 32 ) pool_object
+{
+  int value;
+  char bytes[ 40 ];
+
+  explicit pool_object( int v ) : value( v )
+  {
+    pool_objects++;
+  }
+
+  ~pool_object( )
+  {
+    pool_objects--;
+  }
+};
+
+// If you failed here the slab layout was not worked out at compile time
+static_assert( mavalloc::object_pool< pool_object, 4 >::slot_align == 32, "slot alignment" );
+static_assert( mavalloc::object_pool< pool_object, 4 >::slot_size == 64, "slot size" );
+static_assert( mavalloc::object_pool< pool_object, 4 >::slab_size == 32 + 4 * 64, "slab size" );
+static_assert( mavalloc::object_pool< char, 8 >::slot_size == sizeof( void * ), "small slots hold a link" );
+
+int test_case_5( const char * pName )
+{
+  mavalloc_init( 65536, FIRST_FIT );
+  pool_objects = 0;
+
+  {
+    mavalloc::object_pool< pool_object, 4 > pool;
+    pool_object * objects[ 10 ];
+    int i;
+
+    for( i = 0; i < 10; i++ ) objects[ i ] = pool.create( i );
+
+    // If you failed here the objects were not constructed in place
+    TINYTEST_EQUAL( pool_objects, 10 );
+    TINYTEST_EQUAL( objects[ 7 ]->value, 7 );
+
+    // If you failed here the pool did not take a slab per 4 objects
+    TINYTEST_EQUAL( pool.slabs( ), 3 );
+
+    for( i = 0; i < 10; i++ ) TINYTEST_EQUAL( ( std::uintptr_t ) objects[ i ] % 32, 0 );
+
+    pool.destroy( objects[ 3 ] );
+    pool.destroy( objects[ 5 ] );
+
+    // If you failed here the destructor did not run
+    TINYTEST_EQUAL( pool_objects, 8 );
+
+    // If you failed here freed slots were not reused last in, first out
+    TINYTEST_EQUAL( pool.create( 20 ), objects[ 5 ] );
+    TINYTEST_EQUAL( pool.create( 30 ), objects[ 3 ] );
+    TINYTEST_EQUAL( pool.slabs( ), 3 );
+  }
+
+  // If you failed here the slabs were not given back to the arena
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 );
+  TINYTEST_EQUAL( mavalloc_size( ), 1 );
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 6: Test coroutine frames from the arena
+*
+*/
+struct frame_task
+{
+  struct promise_type : mavalloc::frame_promise_base
+  {
+    int value = 0;
+
+    frame_task get_return_object( )
+    {
+      return frame_task{ std::coroutine_handle< promise_type >::from_promise( *this ) };
+    }
+
+    std::suspend_always initial_suspend( ) noexcept { return { }; }
+    std::suspend_always final_suspend( ) noexcept { return { }; }
+    void return_value( int v ) { value = v; }
+    void unhandled_exception( ) { std::terminate( ); }
+  };
+
+  std::coroutine_handle< promise_type > handle;
+};
+
+frame_task add_in_frame( int a, int b )
+{
+  co_return a + b;
+}
+
+int test_case_6( const char * pName )
+{
+  mavalloc_init( 65536, FIRST_FIT );
+
+  frame_task task1 = add_in_frame( 2, 3 );
+
+  // If you failed here the frame did not come from the arena
+  TINYTEST_ASSERT( mavalloc_used_bytes( ) > 0 );
+
+  task1.handle.resume( );
+  TINYTEST_EQUAL( task1.handle.promise( ).value, 5 );
+
+  void * frame = &task1.handle.promise( );
+  size_t used = mavalloc_used_bytes( );
+  task1.handle.destroy( );
+
+  // If you failed here the freed frame was not kept for reuse
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), used );
+
+  frame_task task2 = add_in_frame( 4, 5 );
+
+  // If you failed here the next frame did not reuse the cached one
+  TINYTEST_EQUAL( ( void * ) &task2.handle.promise( ), frame );
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), used );
+
+  task2.handle.resume( );
+  TINYTEST_EQUAL( task2.handle.promise( ).value, 9 );
+  task2.handle.destroy( );
+
+  // If you failed here drain did not give the frame back
+  mavalloc::frame_cache::drain( );
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 );
+
+  // A frame cached by an arena that was destroyed is never handed out
+  frame_task task3 = add_in_frame( 1, 1 );
+  task3.handle.destroy( );
+  mavalloc_destroy( );
+
+  mavalloc_init( 65536, BEST_FIT );
+
+  frame_task task4 = add_in_frame( 6, 7 );
+  task4.handle.resume( );
+  TINYTEST_EQUAL( task4.handle.promise( ).value, 13 );
+  TINYTEST_ASSERT( mavalloc_used_bytes( ) > 0 );
+  task4.handle.destroy( );
+
+  mavalloc::frame_cache::drain( );
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 );
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+/*
+*
+* TEST CASE 7: Test the standard allocator with node based containers
+*
+*/
+typedef std::map< int, int, std::less< int >, mavalloc::allocator< std::pair< const int, int > > > pool_map;
+
+int test_case_7( const char * pName )
+{
+  mavalloc_init( 1024 * 1024, FIRST_FIT );
+
+  {
+    mavalloc::node_pool pool1;
+    mavalloc::node_pool pool2;
+    int i;
+
+    pool_map map1( ( mavalloc::allocator< std::pair< const int, int > >( &pool1 ) ) );
+
+    for( i = 0; i < 5000; i++ ) map1[ i ] = i * 2;
+
+    // If you failed here the map lost entries
+    TINYTEST_EQUAL( map1.size( ), 5000 );
+    TINYTEST_EQUAL( map1[ 4321 ], 8642 );
+
+    // If you failed here the nodes did not share slabs
+    TINYTEST_ASSERT( pool1.slabs( ) <= 5 );
+
+    for( i = 0; i < 5000; i += 2 ) map1.erase( i );
+
+    // If you failed here freed nodes were not reused
+    size_t slabs = pool1.slabs( );
+    for( i = 0; i < 2500; i++ ) map1[ 10000 + i ] = i;
+    TINYTEST_EQUAL( pool1.slabs( ), slabs );
+
+    // If you failed here the pool did not follow the map on move assignment
+    pool_map map2( ( mavalloc::allocator< std::pair< const int, int > >( &pool2 ) ) );
+    map2 = std::move( map1 );
+    TINYTEST_EQUAL( map2.get_allocator( ).pool( ), &pool1 );
+    TINYTEST_EQUAL( map2.size( ), 5000 );
+
+    // Rebound allocators compare equal when they share a pool
+    mavalloc::allocator< int > ints( &pool1 );
+    mavalloc::allocator< double > doubles( ints );
+    TINYTEST_ASSERT( ints == doubles );
+    TINYTEST_ASSERT( ints != mavalloc::allocator< int >( &pool2 ) );
+
+    std::unordered_map< int, int, std::hash< int >, std::equal_to< int >, mavalloc::allocator< std::pair< const int, int > > >
+      table( 16, std::hash< int >( ), std::equal_to< int >( ), mavalloc::allocator< std::pair< const int, int > >( &pool2 ) );
+
+    for( i = 0; i < 1000; i++ ) table[ i ] = i;
+    TINYTEST_EQUAL( table.at( 999 ), 999 );
+
+    // Without a pool every block comes from the arena
+    std::vector< int, mavalloc::allocator< int > > numbers;
+    numbers.assign( 100, 7 );
+    TINYTEST_EQUAL( numbers[ 99 ], 7 );
+  }
+
+  // If you failed here the pools did not give their slabs back
+  TINYTEST_EQUAL( mavalloc_used_bytes( ), 0 );
+  TINYTEST_EQUAL( mavalloc_size( ), 1 );
+
+  mavalloc_destroy( );
+  return 1;
+}
+
+int tinytest_setup(const char *pName)
+{
+    fprintf( stderr, "tinytest_setup(%s)\n", pName);
+    return 0;
+}
+
+
+
+int tinytest_teardown(const char *pName)
+{
+    fprintf( stderr, "tinytest_teardown(%s)\n", pName);
+    return 0;
+}
+
+
+TINYTEST_START_SUITE(MavAllocCppTestSuite);
+  TINYTEST_ADD_TEST(test_case_1,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_2,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_3,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_4,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_5,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_6,tinytest_setup,tinytest_teardown);
+  TINYTEST_ADD_TEST(test_case_7,tinytest_setup,tinytest_teardown);
+TINYTEST_END_SUITE();
+
+TINYTEST_MAIN_SINGLE_SUITE(MavAllocCppTestSuite);
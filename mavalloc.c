@@ -35,10 +35,45 @@
 #include "mavalloc.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <immintrin.h>
+#define BITMAP_HAVE_AVX2 1
+#endif
+
+// io_uring is driven with raw system calls, so only the kernel headers 
+// are needed
+#if defined( __linux__ ) && defined( __has_include )
+#if __has_include( <linux/io_uring.h> )
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined( __NR_io_uring_setup ) && defined( __NR_io_uring_enter ) && defined( __NR_io_uring_register )
+#define IO_HAVE_URING 1
+#endif
+#endif
+#endif
 
 // Total number of nodes allocated for the stack
 #define NODE_AMOUNT 200
 
+// Set when the public functions serialize on arena_mutex. The mutex is 
+// recursive since public functions call each other, and is set up the 
+// first time thread safety is enabled
+int thread_safe;
+pthread_mutex_t arena_mutex;
+pthread_once_t arena_mutex_once = PTHREAD_ONCE_INIT;
+
+#define ARENA_LOCK( )   if( thread_safe ) pthread_mutex_lock( &arena_mutex )
+#define ARENA_UNLOCK( ) if( thread_safe ) pthread_mutex_unlock( &arena_mutex )
+
 // Pointer to the start of memoryarena
 void * memory_arena;
 
@@ -50,27 +85,175 @@ size_t memory_arena_size;
 // Varible that contains the current algorithm used
 enum ALGORITHM heap_algo;
 
+// Most eligible holes GOOD_FIT looks at before taking the best of them
+int good_fit_candidates = MAVALLOC_GOOD_FIT_CANDIDATES;
+
+// How many percent larger than the request a hole may be for GOOD_FIT to take it at once
+int good_fit_slack = MAVALLOC_GOOD_FIT_SLACK;
+
+// Allocations per ADAPTIVE sampling window
+#define ADAPTIVE_WINDOW 128
+
+// Consecutive windows a new policy has to win before ADAPTIVE switches to it
+#define ADAPTIVE_HYSTERESIS 2
+
+// Failure rate in percent that makes ADAPTIVE prefer BEST_FIT
+#define ADAPTIVE_FAILURE_PERCENT 1
+
+// Average nodes visited per allocation that makes ADAPTIVE prefer NEXT_FIT
+#define ADAPTIVE_LONG_SEARCH 16
+
+// Fit policy the ADAPTIVE algorithm is currently running
+enum ALGORITHM adaptive_algo;
+
+// Policy that won the last ADAPTIVE window, and how many windows in a row it won
+enum ALGORITHM adaptive_candidate;
+int adaptive_streak;
+
+// Allocations, failures and nodes visited in the current ADAPTIVE window
+size_t adaptive_allocations;
+size_t adaptive_failures;
+size_t adaptive_steps;
+
+
+// Number of frees between halving the quick-fit use counters
+#define QUICKFIT_DECAY 256
+
 
 // Enum that specifies hole or process for the node structure
 enum ALLOCATE 
 {
     HOLE = 0,
-    PROCESS = 1
+    PROCESS = 1,
+    CACHED = 2
 };
 
 
 // Node structure for linked list
 // Each node specifies hole or process, the address where it starts, 
 // the size, a pointer to the previous item, and a pointer to the next item.
+// Cached nodes are also linked onto their quick-fit list, and holes are 
+// linked into the Cartesian tree when it is enabled. Serial is the 
+// transaction serial current when the node was last allocated. Purged 
+// is set on holes whose pages were given back by the maintenance thread.
 struct Node 
 {
     enum ALLOCATE type;
     size_t address;
     size_t size;
     struct Node * next;
+    struct Node * quick_next;
+    struct Node * left;
+    struct Node * right;
+    size_t serial;
+    int purged;
 };
 
 
+// Holes are only split when at least this many bytes would be left over
+size_t split_threshold;
+
+// Allocator statistics, reset by mavalloc_init()
+struct mavalloc_stats stats;
+
+// Number of arenas set up by mavalloc_init()
+unsigned int arena_generation;
+
+// Set when every block of the arena starts on its own cache line
+int cache_align;
+
+// Step between the cache colors of large blocks. 0 disables coloring
+size_t color_stride;
+
+// Number of colors to rotate through, and the color of the next block
+int color_count;
+int color_next;
+
+// Serial stamped on allocated nodes. Every mavalloc_txn_begin() moves 
+// it on, so the nodes of a transaction have a larger serial than its mark
+size_t txn_serial;
+
+// Number of transactions that are open
+int txn_depth;
+
+// Blocks that have no node, BITMAP blocks and direct mappings, 
+// allocated while a transaction is open
+void ** txn_log;
+size_t txn_log_length;
+size_t txn_log_capacity;
+
+// Epoch that readers announce when they enter. 0 marks an idle reader
+size_t epoch_global = 1;
+
+// Announced epochs of the readers, each on a cache line of its own so 
+// readers do not slow each other down
+struct EpochSlot
+{
+    size_t epoch;
+    int used;
+} __attribute__(( aligned( 64 ) ));
+
+struct EpochSlot epoch_slots[ MAVALLOC_EPOCH_READERS ];
+
+// Blocks retired in each of the last three epochs, linked through their 
+// first word
+void * retire_lists[ 3 ];
+
+// Number of retired blocks waiting on the retire lists, and how many 
+// wait before reclamation is tried
+size_t retire_pending;
+#define EPOCH_BATCH 64
+
+// Background maintenance thread and the condition it sleeps on
+pthread_t maintenance_thread;
+pthread_mutex_t maintenance_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t maintenance_cond = PTHREAD_COND_INITIALIZER;
+int maintenance_stopping;
+int maintenance_wake;
+
+// Set while the thread runs. Frees read it under the arena lock and 
+// start and stop write it without, so it is only used atomically
+int maintenance_running;
+
+// Time between passes, and the most bytes purged by one pass
+unsigned int maintenance_interval_ms;
+size_t maintenance_budget;
+
+// Frees since the thread was last woken. This many frees wake it early, 
+// but passes never run closer together than MAINTENANCE_MIN_GAP_MS
+size_t maintenance_frees;
+#define MAINTENANCE_WAKE_FREES 1024
+#define MAINTENANCE_MIN_GAP_MS 10
+
+// Holes are only purged when they span at least this many whole pages
+#define MAINTENANCE_PURGE_PAGES 16
+
+// Start of the free tail seen by the last pass, and the passes in a row 
+// that saw it unchanged. The tail is trimmed once it stayed idle for 
+// MAINTENANCE_TRIM_PASSES passes
+size_t maintenance_tail;
+int maintenance_tail_passes;
+#define MAINTENANCE_TRIM_PASSES 2
+
+// Bytes of the blocks handed out and not yet freed, kept up to date by 
+// every allocation and free so the limits are checked in constant time
+size_t used_bytes;
+
+// Used bytes past which the pressure callback is called, and past which 
+// allocations fail. 0 means no limit
+size_t memory_soft_limit;
+size_t memory_hard_limit;
+
+// Called when the arena comes under memory pressure
+mavalloc_pressure_callback pressure_callback;
+void * pressure_context;
+
+// Set once the soft limit was reported, until usage falls below it. 
+// Busy is set while the callback runs so its own calls do not reenter it
+int pressure_signalled;
+int pressure_busy;
+
+
 // Pointer to node that points to the head of the linked list (first node)
 // Necessary for the triple reference technique for linked lists
 struct Node * head_pointer = NULL;
@@ -146,6 +329,10 @@ struct Node * new_node( enum ALLOCATE type, size_t address, size_t size )
     if ( new == NULL ) return new;
 
     new->next = NULL;
+    new->left = NULL;
+    new->right = NULL;
+    new->serial = txn_serial;
+    new->purged = 0;
     new->type = type;
     new->address = address;
     new->size = size;
@@ -154,444 +341,5393 @@ struct Node * new_node( enum ALLOCATE type, size_t address, size_t size )
 }
 
 
+// Which structure indexes the holes. HOLE_INDEX_CARTESIAN keeps the holes
+// in a Cartesian tree alongside the linked list
+enum HOLE_INDEX hole_index = HOLE_INDEX_LIST;
+
+// Root of the Cartesian tree of holes. The tree is a binary search tree
+// by address and a max-heap by size, so every subtree root is the 
+// largest hole of its address range (Stephenson's fast fits)
+struct Node * hole_root;
+
 /**
- * @brief Initialize the allocation arena and set the algorithm type
+ * @brief Splits a Cartesian tree by address
  *
- * This function takes the provided size and calls malloc to allocate a 
- * memory arena. The size must be aligned to a word boundary.
- * 
- * If the allocation succeeds it returns 0. If the allocation fails or the 
- * size is less than 0 the function returns -1
+ * \param root The tree to split
+ * \param address Holes below this address go left, the rest go right
+ * \param left Receives the tree of lower holes
+ * \param right Receives the tree of higher holes
+ * \return None
+ **/
+void tree_split( struct Node * root, size_t address, struct Node ** left, struct Node ** right )
+{
+    if( root == NULL )
+    {
+        *left = NULL;
+        *right = NULL;
+    }
+    else if( root->address < address )
+    {
+        tree_split( root->right, address, &root->right, right );
+        *left = root;
+    }
+    else
+    {
+        tree_split( root->left, address, left, &root->left );
+        *right = root;
+    }
+}
+
+/**
+ * @brief Joins two Cartesian trees
  *
- * \param size The size of the pool to allocate in bytes
- * \param algorithm The heap algorithm to implement
- * \return 0 on success. -1 on failure
+ * \param left A tree whose holes are all below those of right
+ * \param right A tree whose holes are all above those of left
+ * \return The root of the joined tree
  **/
-int mavalloc_init( size_t size, enum ALGORITHM algorithm )
+struct Node * tree_merge( struct Node * left, struct Node * right )
 {
-    if ( size < 0 ) return -1;
-    
-    // 4 byte word align size
-    size_t requested_size = ALIGN4( size );
+    if( left == NULL ) return right;
+    if( right == NULL ) return left;
 
-    // If malloc() succeeds, malloc() returns a void pointer pointing 
-    // to the memory allocated
-    memory_arena = malloc( requested_size );
+    if( left->size >= right->size )
+    {
+        left->right = tree_merge( left->right, right );
+        return left;
+    }
 
-    // If malloc() fails, malloc() returns a NULL pointer
-    if ( memory_arena == NULL ) return -1;
+    right->left = tree_merge( left, right->left );
+    return right;
+}
 
-    // Sets size of the memory arena
-    memory_arena_size = requested_size;
+/**
+ * @brief Adds a hole to the hole index
+ *
+ * \param hole The hole node
+ * \return None
+ **/
+void hole_index_add( struct Node * hole )
+{
+    if( hole_index != HOLE_INDEX_CARTESIAN ) return;
 
-    // Initialize node stack
-    node_stack_init( NODE_AMOUNT );
+    // Walk down until the new hole is larger than the subtree root
+    struct Node ** link = &hole_root;
 
-    // Sets current algorithm
-    heap_algo = algorithm;
+    while( *link != NULL && ( *link )->size >= hole->size )
+    {
+        link = ( hole->address < ( *link )->address ) ? &( *link )->left : &( *link )->right;
+    }
 
-    // Initiate the head pointer, used in triple reference technique
-    head_pointer = new_node( HOLE, 0, 0 );
+    // The new hole takes the place of that subtree, split around its address
+    tree_split( *link, hole->address, &hole->left, &hole->right );
 
-    // If new_node() fails, new_node() returns a NULL pointer
-    if ( head_pointer == NULL ) return -1;
+    *link = hole;
+}
 
-    // Initiate hole type head node (first node in linked list)
-    head_pointer->next = new_node( HOLE, 0, requested_size );
+/**
+ * @brief Removes a hole from the hole index
+ *
+ * \param hole The hole node
+ * \return None
+ **/
+void hole_index_remove( struct Node * hole )
+{
+    if( hole_index != HOLE_INDEX_CARTESIAN ) return;
 
-    // If new_node() fails, new_node() returns a NULL pointer
-    if ( head_pointer->next == NULL ) return -1;
+    struct Node ** link = &hole_root;
 
-    // Set the initial previous node to the head node
-    previous_node = head_pointer;
+    while( *link != NULL && *link != hole )
+    {
+        link = ( hole->address < ( *link )->address ) ? &( *link )->left : &( *link )->right;
+    }
 
-    return 0;
-}
+    if( *link == NULL ) return;
+
+    *link = tree_merge( hole->left, hole->right );
 
+    hole->left = NULL;
+    hole->right = NULL;
+}
 
 /**
- * @brief Destroy the arena
- *
- * This function releases all allocated memory.
- * First it frees all the nodes in the linked link.
- * Then it frees the memory arena.
+ * @brief Re-indexes a hole whose size changed
  *
- * \return None 
+ * \param hole The hole node
+ * \return None
  **/
-void mavalloc_destroy( )
+void hole_index_update( struct Node * hole )
 {
-    // Check if linked list exists
-    if( head_pointer == NULL ) return;
+    hole_index_remove( hole );
+    hole_index_add( hole );
+}
 
-    // Starting from the pointer to the head of the linked list, 
-    // free all nodes in the linked list
-    //struct Node * runner = head_pointer;
-    //struct Node * node;
+/**
+ * @brief Rebuilds the hole index from the linked list
+ *
+ * \return None
+ **/
+void hole_index_rebuild( )
+{
+    hole_root = NULL;
 
-    //while( runner != NULL ) 
-    //{
-    //    node = runner;
-    //    runner = runner->next;
-    //    node_free( node );
-    //}
+    if( hole_index != HOLE_INDEX_CARTESIAN || head_pointer == NULL ) return;
 
-    // Free the all the nodes allocated in the node_stack array
-    free( node_stack );
+    struct Node * runner = head_pointer->next;
 
-    // Free the memory arena
-    free( memory_arena );
+    while( runner != NULL )
+    {
+        if( runner->type == HOLE ) hole_index_add( runner );
 
-    // Remove access to linked list address
-    head_pointer = NULL;
+        runner = runner->next;
+    }
+}
 
-    // Remove access to previous node pointer
-    previous_node = NULL;
+/**
+ * @brief Finds the lowest addressed hole that fits
+ *
+ * A subtree can only hold a fitting hole if its root fits, so the search
+ * goes left whenever the left subtree fits and stops at the first node 
+ * that fits once the left side does not.
+ *
+ * \param size The size of space being requested
+ * \return The hole node. NULL if no hole fits
+ **/
+struct Node * tree_first_fit( size_t size )
+{
+    struct Node * node = hole_root;
 
-    // Remove access to the stack head
-    stack_head = NULL;
+    if( node == NULL || node->size < size ) return NULL;
 
-    return;
+    while( 1 )
+    {
+        if( node->left != NULL && node->left->size >= size ) node = node->left;
+        else if( node->size >= size ) return node;
+        else node = node->right;
+    }
 }
 
 /**
- * @brief Allocates a node of a specified size at the specified hole
+ * @brief Finds a small hole that fits
  *
- * \param hole_ptr The node pointing to the hole node containing the space to be allocated
- * \param size The number of bytes that will be allocated from the hole node
- * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ * Stephenson's better fit: walks down one path, always into the smaller
+ * child that still fits, and keeps the smallest hole seen on the way.
+ * This looks at one node per level instead of every hole, and usually 
+ * lands on or next to the best fit.
+ *
+ * \param size The size of space being requested
+ * \return The hole node. NULL if no hole fits
  **/
-void * allocate_node( struct Node * hole_ptr , size_t size )
+struct Node * tree_better_fit( size_t size )
 {
-    // Fails if hole pointer doesn't exist
-    if( hole_ptr == NULL ) return NULL;
+    struct Node * best = NULL;
+    struct Node * node = hole_root;
 
-    // Split the hole node into a process node and a hole node
-    // Process node will have the requested size
-    // Hole node will contain the remaining space
+    while( node != NULL && node->size >= size )
+    {
+        if( best == NULL || node->size < best->size ) best = node;
 
-    // First create the new process node at the hole's address
-    struct Node * new = new_node( PROCESS, hole_ptr->next->address, size );
+        struct Node * left = ( node->left != NULL && node->left->size >= size ) ? node->left : NULL;
+        struct Node * right = ( node->right != NULL && node->right->size >= size ) ? node->right : NULL;
 
-    // If new_node() fails, new_node() returns NULL
-    if( new == NULL ) return NULL;
+        if( left != NULL && right != NULL ) node = ( left->size <= right->size ) ? left : right;
+        else node = ( left != NULL ) ? left : right;
 
-    // If no space left in the memory arena, delete the hole node
-    if( hole_ptr->next->address + size >= memory_arena_size ) 
-    {
-        node_free( hole_ptr->next );
+        stats.search_steps++;
     }
-    else
-    {
-        // Update old hole to remaining space
-        hole_ptr->next->address = hole_ptr->next->address + size;
-        hole_ptr->next->size = hole_ptr->next->size - size;
 
-        // If old hole has no space left, delete the hole node
-        if( hole_ptr->next->size <= 0 )
-        {
-            new->next = hole_ptr->next->next;
-            node_free( hole_ptr->next );
-        }
-        // Else point to the hole node
-        else
-        {
-            new->next = hole_ptr->next;
-        }
-    }
+    return best;
+}
+
+/**
+ * @brief mavalloc_set_hole_index() without taking the arena lock
+ **/
+int set_hole_index_unlocked( enum HOLE_INDEX index )
+{
+    if( index != HOLE_INDEX_LIST && index != HOLE_INDEX_CARTESIAN ) return -1;
 
-    // Point to the new process node
-    hole_ptr->next = new;
+    hole_index = index;
 
-    //Return allocated memory arena address
-    return memory_arena + new->address;
+    // Index the holes of the current arena
+    hole_index_rebuild( );
+
+    return 0;
 }
 
 
 /**
- * @brief First fit heap allocation algorithm
+ * @brief Select the structure that indexes the holes
  *
- * \param size The size of space being requested to be allocated
- * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ * HOLE_INDEX_LIST (the default) finds holes by walking the address 
+ * ordered linked list. HOLE_INDEX_CARTESIAN also keeps the holes in a 
+ * Cartesian tree that is ordered by address and heap ordered by size, 
+ * as in Stephenson's fast fits. FIRST_FIT then finds the lowest fitting 
+ * hole, BEST_FIT a small fitting hole ("better fit") and WORST_FIT the 
+ * largest hole, each down a single path of the tree instead of a full 
+ * walk of the list. Better fit looks at one hole per level, so it may 
+ * settle for a hole slightly larger than the true best fit. The other 
+ * algorithms keep walking the list. The index can be changed at any time.
+ *
+ * \param index HOLE_INDEX_LIST or HOLE_INDEX_CARTESIAN
+ * \return 0 on success. -1 if the index is unknown
  **/
-void * alloc_first_fit( size_t size ) 
+int mavalloc_set_hole_index( enum HOLE_INDEX index )
 {
-    // Check if linked list exists
-    if( head_pointer == NULL ) return NULL;
+    ARENA_LOCK( );
+    int result = set_hole_index_unlocked( index );
+    ARENA_UNLOCK( );
 
-    // Starting from the head of the linked list, 
-    // find the first hole that is large enough for the requested size
-    struct Node * runner = head_pointer;  // Head pointer points to head node
+    return result;
+}
 
-    while( runner->next->type == PROCESS || runner->next->size < size )
-    {
-        runner = runner->next;
 
-        // The end of the linked list has been reached
-        // There are no eligible holes left
-        if( runner->next == NULL ) return NULL;
-    }
+// Number of bytes covered by one bit of the BITMAP occupancy map
+size_t bitmap_unit = MAVALLOC_BITMAP_UNIT;
 
-    // runner->next is now the hole node with the available space
-    // runner points to the hole node
-    return allocate_node( runner, size );
-}
+// Number of allocation units tracked by the BITMAP occupancy map
+size_t bitmap_units;
+
+// Number of 64-bit words in each of the BITMAP maps
+size_t bitmap_words;
+
+// Occupancy map, one bit per unit. A set bit means the unit is in use.
+// Bits past the last unit are kept set so a search never hands them out
+uint64_t * bitmap_used;
+
+// Run end map, one bit per unit. A set bit marks the last unit of an 
+// allocated run so free can find the length of the run without a 
+// per-unit side array
+uint64_t * bitmap_ends;
+
+// Lowest word of the occupancy map that may still contain a free unit
+size_t bitmap_hint;
+
+// Set when the CPU can scan the occupancy map with AVX2
+int bitmap_use_avx2;
 
 
 /**
- * @brief Next fit heap allocation algorithm
+ * @brief Set the allocation unit of the BITMAP algorithm
  *
- * \param size The size of space being requested to be allocated
- * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ * The BITMAP algorithm tracks the arena with one occupancy bit per unit
+ * and hands out whole runs of units. The unit must be a power of two of
+ * at least 4 bytes and takes effect on the next call to mavalloc_init.
+ *
+ * \param unit The number of bytes covered by one bit
+ * \return 0 on success. -1 if the unit is invalid
  **/
-void * alloc_next_fit( size_t size )
+int mavalloc_set_bitmap_unit( size_t unit )
 {
-    // check if the linked list exists
-    if ( head_pointer == NULL ) return NULL;
+    // Units must be word aligned powers of two so offsets divide evenly
+    if( unit < 4 || ( unit & ( unit - 1 ) ) != 0 ) return -1;
 
-    // starting from the previous node in the linked list,
-    // find the next hole that is large enough for the requested size
-    struct Node * runner = previous_node; // runner pointer points to node previously left off on
+    bitmap_unit = unit;
+
+    return 0;
+}
 
-    while ( runner->next->type == PROCESS || runner->next->size < size )
+/**
+ * @brief Sets or clears a range of bits in a bitmap
+ *
+ * \param map The bitmap to update
+ * \param first The index of the first bit to update
+ * \param count The number of bits to update
+ * \param value Non-zero to set the bits, zero to clear them
+ * \return None
+ **/
+void bitmap_set_range( uint64_t * map, size_t first, size_t count, int value )
+{
+    while( count > 0 )
     {
-        runner = runner->next;
+        size_t word = first >> 6;
+        size_t bit = first & 63;
 
-        // If end of the linked list is hit, loop back to the head
-        if( runner->next == NULL ) runner = head_pointer;
+        // Number of bits of the range that land in this word
+        size_t span = 64 - bit;
+        if( span > count ) span = count;
 
-        // The linked list has been completely looped and is back to where it started
-        // There are no eligible holes left
-        if( runner == previous_node ) return NULL;
-    }
+        uint64_t mask = ( span == 64 ) ? ~0ULL : ( ( ( 1ULL << span ) - 1 ) << bit );
 
-    // Update the previous node to the hole node with the available space
-    previous_node = runner;
+        if( value ) map[ word ] |= mask;
+        else        map[ word ] &= ~mask;
 
-    // runner->next is now the hole node with the available space
-    // runner points to the hole node
-    return allocate_node( runner, size );
+        first = first + span;
+        count = count - span;
+    }
 }
 
+#ifdef BITMAP_HAVE_AVX2
 /**
- * @brief Best fit heap allocation algorithm
+ * @brief AVX2 version of bitmap_skip_full()
  *
- * \param size The size of space being requested to be allocated
- * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ * Tests four words of the occupancy map per instruction
+ *
+ * \param word The word to start from
+ * \return The index of the first word that is not full
  **/
-void * alloc_best_fit( size_t size )
+__attribute__(( target( "avx2" ) ))
+size_t bitmap_skip_full_avx2( size_t word )
 {
-    // check if the linked list exists
-    if ( head_pointer == NULL ) return NULL;
+    const __m256i ones = _mm256_set1_epi64x( -1 );
 
-    struct Node * best_hole_ptr = NULL;
-    size_t min = memory_arena_size+1;
+    while( word + 4 <= bitmap_words )
+    {
+        __m256i block = _mm256_loadu_si256( (const __m256i *)( bitmap_used + word ) );
 
-    // Iterate through the linked list
-    // Store the smallest eligible hole into best_hole_ptr
-    struct Node * runner = head_pointer;
+        // testc is set only when every bit of the block is set
+        if( !_mm256_testc_si256( block, ones ) ) break;
+
+        word = word + 4;
+    }
+
+    while( word < bitmap_words && bitmap_used[ word ] == ~0ULL ) word++;
+
+    return word;
+}
+#endif
+
+/**
+ * @brief Skips over words of the occupancy map with no free units
+ *
+ * \param word The word to start from
+ * \return The index of the first word that is not full, or bitmap_words
+ **/
+size_t bitmap_skip_full( size_t word )
+{
+#ifdef BITMAP_HAVE_AVX2
+    if( bitmap_use_avx2 ) return bitmap_skip_full_avx2( word );
+#endif
+
+    while( word < bitmap_words && bitmap_used[ word ] == ~0ULL ) word++;
+
+    return word;
+}
+
+/**
+ * @brief Finds the lowest run of free units of the requested length
+ *
+ * Full words are skipped a word (or four with AVX2) at a time. Inside a 
+ * partially used word the free bits are folded onto themselves so that 
+ * every remaining bit marks the start of a long enough run. Runs that 
+ * cross word boundaries are carried from the free high bits of one word 
+ * into the free low bits of the next.
+ *
+ * \param count The number of free units needed
+ * \return The index of the first unit of the run. bitmap_units on failure
+ **/
+size_t bitmap_find_run( size_t count )
+{
+    size_t run_start = 0;
+    size_t run_length = 0;
+
+    // Every word below the hint is known to be full
+    size_t word = bitmap_skip_full( bitmap_hint );
+    bitmap_hint = word;
+
+    while( word < bitmap_words )
+    {
+        uint64_t used = bitmap_used[ word ];
+
+        // A full word ends any run carried from the previous word
+        if( used == ~0ULL )
+        {
+            run_length = 0;
+            word = bitmap_skip_full( word );
+            continue;
+        }
+
+        // An empty word extends the carried run by a whole word
+        if( used == 0 )
+        {
+            if( run_length == 0 ) run_start = word * 64;
+            run_length = run_length + 64;
+
+            if( run_length >= count ) return run_start;
+
+            word++;
+            continue;
+        }
+
+        // Extend the run carried from the previous word with the free low bits
+        if( run_length > 0 && run_length + __builtin_ctzll( used ) >= count ) return run_start;
+
+        // Look for a run that fits completely inside this word
+        if( count <= 64 )
+        {
+            uint64_t starts = ~used;
+            size_t length = 1;
+
+            while( length < count )
+            {
+                size_t shift = ( length < count - length ) ? length : count - length;
+                starts = starts & ( starts >> shift );
+                length = length + shift;
+            }
+
+            if( starts ) return word * 64 + __builtin_ctzll( starts );
+        }
+
+        // Carry the free high bits into the next word
+        run_length = __builtin_clzll( used );
+        run_start = word * 64 + 64 - run_length;
+
+        word++;
+    }
+
+    return bitmap_units;
+}
+
+/**
+ * @brief Finds the end of the allocated run starting at a unit
+ *
+ * \param first The first unit of an allocated run
+ * \return The index of the last unit of the run
+ **/
+size_t bitmap_run_end( size_t first )
+{
+    size_t word = first >> 6;
+    uint64_t ends = bitmap_ends[ word ] & ( ~0ULL << ( first & 63 ) );
+
+    while( ends == 0 )
+    {
+        word++;
+        ends = bitmap_ends[ word ];
+    }
+
+    return word * 64 + __builtin_ctzll( ends );
+}
+
+/**
+ * @brief Finds the next used unit at or after a unit
+ *
+ * \param first The unit to start from
+ * \return The index of the next used unit. bitmap_units if there is none
+ **/
+size_t bitmap_next_used( size_t first )
+{
+    size_t word = first >> 6;
+    uint64_t used = bitmap_used[ word ] & ( ~0ULL << ( first & 63 ) );
+
+    while( used == 0 )
+    {
+        word++;
+        if( word >= bitmap_words ) return bitmap_units;
+        used = bitmap_used[ word ];
+    }
+
+    size_t unit = word * 64 + __builtin_ctzll( used );
+
+    return ( unit < bitmap_units ) ? unit : bitmap_units;
+}
+
+/**
+ * @brief Builds the BITMAP maps for an arena
+ *
+ * \param arena_size The size of the memory arena in bytes
+ * \param capacity The size the arena may grow to. Ignored if smaller than arena_size
+ * \return 0 on success. -1 on failure
+ **/
+int bitmap_init( size_t arena_size, size_t capacity )
+{
+    bitmap_units = arena_size / bitmap_unit;
+
+    // The arena must hold at least one unit
+    if( bitmap_units == 0 ) return -1;
+
+    // Size the maps for the largest the arena can grow to
+    if( capacity < arena_size ) capacity = arena_size;
+
+    bitmap_words = ( capacity / bitmap_unit + 63 ) / 64;
+
+    bitmap_used = (uint64_t *)calloc( bitmap_words, sizeof( uint64_t ) );
+    bitmap_ends = (uint64_t *)calloc( bitmap_words, sizeof( uint64_t ) );
+
+    if( bitmap_used == NULL || bitmap_ends == NULL )
+    {
+        free( bitmap_used );
+        free( bitmap_ends );
+        bitmap_used = NULL;
+        bitmap_ends = NULL;
+        return -1;
+    }
+
+    // Mark the bits past the last unit as used so they are never handed out
+    bitmap_set_range( bitmap_used, bitmap_units, bitmap_words * 64 - bitmap_units, 1 );
+
+    bitmap_hint = 0;
+
+#ifdef BITMAP_HAVE_AVX2
+    bitmap_use_avx2 = __builtin_cpu_supports( "avx2" );
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief Hands the units of a grown arena to the BITMAP algorithm
+ *
+ * \param arena_size The new size of the memory arena in bytes
+ * \return None
+ **/
+void bitmap_grow( size_t arena_size )
+{
+    size_t units = arena_size / bitmap_unit;
+
+    if( units <= bitmap_units ) return;
+
+    // The new units were marked as used when the maps were built
+    bitmap_set_range( bitmap_used, bitmap_units, units - bitmap_units, 0 );
+
+    if( ( bitmap_units >> 6 ) < bitmap_hint ) bitmap_hint = bitmap_units >> 6;
+
+    bitmap_units = units;
+}
+
+/**
+ * @brief Releases the BITMAP maps
+ *
+ * \return None
+ **/
+void bitmap_destroy( )
+{
+    free( bitmap_used );
+    free( bitmap_ends );
+
+    bitmap_used = NULL;
+    bitmap_ends = NULL;
+    bitmap_units = 0;
+    bitmap_words = 0;
+}
+
+/**
+ * @brief Bitmap heap allocation algorithm
+ *
+ * Rounds the request up to whole units and marks the lowest free run of
+ * that many units as used.
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_bitmap( size_t size )
+{
+    // Check if the maps exist
+    if( bitmap_used == NULL ) return NULL;
+
+    size_t count = ( size + bitmap_unit - 1 ) / bitmap_unit;
+    if( count == 0 ) count = 1;
+
+    size_t first = bitmap_find_run( count );
+
+    // No run of free units is long enough
+    if( first >= bitmap_units ) return NULL;
+
+    bitmap_set_range( bitmap_used, first, count, 1 );
+    bitmap_set_range( bitmap_ends, first + count - 1, 1, 1 );
+
+    used_bytes = used_bytes + count * bitmap_unit;
+
+    return memory_arena + first * bitmap_unit;
+}
+
+/**
+ * @brief Returns a run allocated by alloc_bitmap() to the occupancy map
+ *
+ * \param ptr The start of the run
+ * \return 1 if the run was freed. 0 if ptr does not start a run
+ **/
+int free_bitmap( void * ptr )
+{
+    // Check if the maps exist
+    if( bitmap_used == NULL ) return 0;
+
+    size_t offset = ptr - memory_arena;
+
+    // Ignore pointers that are not the start of a unit in the arena
+    if( ptr < memory_arena || offset % bitmap_unit != 0 ) return 0;
+
+    size_t first = offset / bitmap_unit;
+
+    if( first >= bitmap_units ) return 0;
+    if( ( bitmap_used[ first >> 6 ] & ( 1ULL << ( first & 63 ) ) ) == 0 ) return 0;
+
+    // Ignore units in the middle of a run
+    if( first > 0 && ( bitmap_used[ ( first - 1 ) >> 6 ] & ( 1ULL << ( ( first - 1 ) & 63 ) ) ) 
+                  && ( bitmap_ends[ ( first - 1 ) >> 6 ] & ( 1ULL << ( ( first - 1 ) & 63 ) ) ) == 0 ) return 0;
+
+    size_t last = bitmap_run_end( first );
+
+    bitmap_set_range( bitmap_used, first, last - first + 1, 0 );
+    bitmap_set_range( bitmap_ends, last, 1, 0 );
+
+    used_bytes = used_bytes - ( last - first + 1 ) * bitmap_unit;
+
+    // The freed run may sit below the current search hint
+    if( ( first >> 6 ) < bitmap_hint ) bitmap_hint = first >> 6;
+
+    return 1;
+}
+
+/**
+ * @brief Walks the runs of the occupancy map
+ *
+ * Used and free runs are reported in address order, the same way 
+ * process and hole nodes appear in the linked list.
+ *
+ * \param print Non-zero to print every run
+ * \return The number of runs
+ **/
+int bitmap_walk( int print )
+{
+    int number_of_runs = 0;
+    size_t unit = 0;
+
+    while( unit < bitmap_units )
+    {
+        size_t next;
+        enum ALLOCATE type;
+
+        if( bitmap_used[ unit >> 6 ] & ( 1ULL << ( unit & 63 ) ) )
+        {
+            type = PROCESS;
+            next = bitmap_run_end( unit ) + 1;
+        }
+        else
+        {
+            type = HOLE;
+            next = bitmap_next_used( unit );
+        }
+
+        number_of_runs++;
+
+        if( print )
+        {
+            printf(" %d) type = %d, address = %ld, size = %ld \n", number_of_runs, type, unit * bitmap_unit, ( next - unit ) * bitmap_unit);
+        }
+
+        unit = next;
+    }
+
+    return number_of_runs;
+}
+
+
+// Every RING block starts with a header holding the size of the block 
+// (header included). The low bit is set once the block has been freed
+#define RING_HEADER sizeof( size_t )
+#define RING_RELEASED 1
+
+// Offset of the oldest block in the RING buffer
+size_t ring_head;
+
+// Offset where the RING buffer places the next block
+size_t ring_tail;
+
+// Number of blocks between ring_head and ring_tail, including blocks 
+// that were freed out of order and padding left when the buffer wrapped
+size_t ring_blocks;
+
+// Number of blocks ever placed in the RING buffer, padding included. The 
+// blocks still in the buffer are the last ring_blocks of them
+size_t ring_pushed;
+
+/**
+ * @brief Wraps a RING offset back to the start of the arena
+ *
+ * There is no room for a header in the last few bytes of the arena so 
+ * an offset that gets that close to the end continues at the start.
+ *
+ * \param offset The offset to wrap
+ * \return The wrapped offset
+ **/
+size_t ring_wrap( size_t offset )
+{
+    if( memory_arena_size - offset < RING_HEADER ) return 0;
+
+    return offset;
+}
+
+/**
+ * @brief Returns the RING header at an offset in the arena
+ *
+ * \param offset The offset of the block
+ * \return A pointer to the header of the block
+ **/
+size_t * ring_header( size_t offset )
+{
+    return (size_t *)( memory_arena + offset );
+}
+
+/**
+ * @brief Ring heap allocation algorithm
+ *
+ * Uses the arena as a circular buffer. Blocks are placed at the tail, 
+ * and when the space up to the end of the arena is too small the buffer 
+ * wraps around to the start as long as the oldest block has moved on.
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_ring( size_t size )
+{
+    // Header plus payload, kept 8 byte aligned so headers stay aligned
+    size_t total = ( size + RING_HEADER + 7 ) & ~(size_t)7;
+
+    // An empty buffer starts over at the beginning of the arena
+    if( ring_blocks == 0 )
+    {
+        ring_head = 0;
+        ring_tail = 0;
+    }
+
+    // When the tail is behind the head the free space is the gap between 
+    // them. A full buffer also has the tail sitting on the head
+    int wrapped = ring_tail < ring_head || ( ring_blocks > 0 && ring_tail == ring_head );
+
+    if( wrapped )
+    {
+        if( total > ring_head - ring_tail ) return NULL;
+    }
+    else if( total > memory_arena_size - ring_tail )
+    {
+        // Not enough space before the end of the arena, try the start
+        if( total > ring_head ) return NULL;
+
+        // Pad out the end of the arena so the head knows to skip it
+        if( memory_arena_size - ring_tail >= RING_HEADER )
+        {
+            *ring_header( ring_tail ) = ( memory_arena_size - ring_tail ) | RING_RELEASED;
+            ring_blocks++;
+            ring_pushed++;
+        }
+
+        ring_tail = 0;
+    }
+
+    size_t offset = ring_tail;
+
+    *ring_header( offset ) = total;
+    used_bytes = used_bytes + total;
+
+    ring_tail = ring_wrap( offset + total );
+    ring_blocks++;
+    ring_pushed++;
+
+    return memory_arena + offset + RING_HEADER;
+}
+
+/**
+ * @brief Moves the head past every freed block at the front of the buffer
+ *
+ * \return None
+ **/
+void ring_release_front( )
+{
+    while( ring_blocks > 0 && ( *ring_header( ring_head ) & RING_RELEASED ) )
+    {
+        ring_head = ring_wrap( ring_head + ( *ring_header( ring_head ) & ~(size_t)RING_RELEASED ) );
+        ring_blocks--;
+    }
+}
+
+/**
+ * @brief Frees a RING block
+ *
+ * The oldest blocks are released by moving the head past them. A block 
+ * freed out of order is only marked and is released once the head 
+ * catches up with it.
+ *
+ * \param ptr The block to free
+ * \return None
+ **/
+void free_ring( void * ptr )
+{
+    // Ignore pointers that are not inside the arena
+    if( ptr < memory_arena + RING_HEADER || ptr >= memory_arena + memory_arena_size ) return;
+
+    size_t * header = (size_t *)( ptr - RING_HEADER );
+
+    if( *header & RING_RELEASED ) return;
+
+    used_bytes = used_bytes - *header;
+    *header = *header | RING_RELEASED;
+
+    ring_release_front( );
+}
+
+/**
+ * @brief Walks the blocks of the RING buffer from oldest to newest
+ *
+ * \param print Non-zero to print every block
+ * \return The number of blocks
+ **/
+int ring_walk( int print )
+{
+    size_t offset = ring_head;
+    size_t i;
+
+    for( i = 0; i < ring_blocks; i++ )
+    {
+        size_t header = *ring_header( offset );
+        size_t size = header & ~(size_t)RING_RELEASED;
+
+        if( print )
+        {
+            printf(" %ld) type = %d, address = %ld, size = %ld \n", i + 1, ( header & RING_RELEASED ) ? HOLE : PROCESS, offset, size);
+        }
+
+        offset = ring_wrap( offset + size );
+    }
+
+    return ring_blocks;
+}
+
+
+// Size-class rounding policy applied to every request
+enum ROUNDING rounding_policy = ROUND_ALIGN4;
+
+// Quantum used by the ROUND_QUANTUM policy
+size_t rounding_quantum = 4;
+
+/**
+ * @brief Set the size-class rounding policy
+ *
+ * ROUND_ALIGN4 (the default) only aligns requests to 4 bytes. 
+ * ROUND_QUANTUM rounds up to a multiple of the quantum, ROUND_POWER_OF_TWO
+ * to the next power of two, and ROUND_GEOMETRIC to one of four classes 
+ * per doubling (20, 24, 28, 32, 40, 48, ...). Coarser classes make freed 
+ * holes reusable by more requests at the cost of internal fragmentation,
+ * which is reported in the statistics.
+ *
+ * \param policy The rounding policy
+ * \param quantum The size class spacing for ROUND_QUANTUM. It must be a 
+ *                multiple of 4 and is ignored by the other policies
+ * \return 0 on success. -1 if the quantum is invalid
+ **/
+int mavalloc_set_rounding( enum ROUNDING policy, size_t quantum )
+{
+    if( policy == ROUND_QUANTUM && ( quantum == 0 || quantum % 4 != 0 ) ) return -1;
+
+    rounding_policy = policy;
+
+    if( policy == ROUND_QUANTUM ) rounding_quantum = quantum;
+
+    return 0;
+}
+
+/**
+ * @brief Rounds a request up to its size class
+ *
+ * \param size The number of bytes requested
+ * \return The size of the size class. 0 if the class would overflow
+ **/
+size_t round_size( size_t size )
+{
+    // 4 byte word align size
+    size_t rounded = ALIGN4( size );
+
+    if( rounded < size ) return 0;
+
+    switch( rounding_policy )
+    {
+        case ROUND_QUANTUM:
+            rounded = ( ( rounded + rounding_quantum - 1 ) / rounding_quantum ) * rounding_quantum;
+            break;
+        case ROUND_POWER_OF_TWO:
+            {
+                size_t power = 4;
+                while( power < rounded && power != 0 ) power = power << 1;
+                rounded = power;
+            }
+            break;
+        case ROUND_GEOMETRIC:
+            // Four classes between each power of two, so the spacing 
+            // between classes in [2^k, 2^(k+1)) is 2^(k-2)
+            if( rounded > 16 )
+            {
+                int k = 63 - __builtin_clzll( rounded - 1 );
+                size_t spacing = (size_t)1 << ( k - 2 );
+                rounded = ( rounded + spacing - 1 ) & ~( spacing - 1 );
+            }
+            break;
+        default:
+            break;
+    }
+
+    // Rounding wrapped around
+    if( rounded < size ) return 0;
+
+    return rounded;
+}
+
+
+// Quick-fit list of freed blocks that all have the same exact size
+struct QuickList
+{
+    size_t size;
+    int count;
+    int pinned;
+    unsigned long uses;
+    struct Node * top;
+};
+
+// Quick-fit lists checked before the heap algorithm
+struct QuickList quick_lists[ MAVALLOC_QUICKFIT_MAX ];
+
+// Number of quick-fit lists in use. 0 disables quick-fit
+int quick_list_amount;
+
+// Maximum number of blocks parked on one quick-fit list
+int quick_list_depth;
+
+// Number of blocks parked on all quick-fit lists
+int quick_cached;
+
+// Number of allocations served from the quick-fit lists
+size_t quick_pops;
+
+// Frees since the use counters were last halved
+int quick_frees;
+
+/**
+ * @brief Reports if an algorithm manages the arena with the node list
+ *
+ * \param algorithm The heap algorithm
+ * \return 1 if the algorithm uses the node list. 0 otherwise
+ **/
+int uses_node_list( enum ALGORITHM algorithm )
+{
+    switch( algorithm )
+    {
+        case FIRST_FIT:
+        case NEXT_FIT:
+        case BEST_FIT:
+        case WORST_FIT:
+        case ADAPTIVE:
+        case GOOD_FIT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Coalesces every run of adjacent free nodes in one pass
+ *
+ * Cached nodes are turned back into holes first.
+ *
+ * \return None
+ **/
+void coalesce_all( )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return;
+
+    struct Node * runner = head_pointer->next;
+
+    while( runner != NULL )
+    {
+        if( runner->type == CACHED )
+        {
+            runner->type = HOLE;
+            runner->purged = 0;
+        }
+
+        // Absorb every free node that follows this hole
+        while( runner->type == HOLE && runner->next != NULL && runner->next->type != PROCESS )
+        {
+            struct Node * node = runner->next;
+
+            runner->size = runner->size + node->size;
+            runner->purged = runner->purged && node->purged && node->type == HOLE;
+            runner->next = node->next;
+
+            if( previous_node == node ) previous_node = runner;
+
+            node_free( node );
+        }
+
+        runner = runner->next;
+    }
+
+    // Holes were merged and cached blocks became holes
+    hole_index_rebuild( );
+}
+
+/**
+ * @brief Returns every cached block to the heap
+ *
+ * \return None
+ **/
+void quickfit_flush( )
+{
+    int i;
+
+    for( i = 0; i < MAVALLOC_QUICKFIT_MAX; i++ )
+    {
+        quick_lists[ i ].top = NULL;
+        quick_lists[ i ].count = 0;
+    }
+
+    if( quick_cached == 0 ) return;
+
+    quick_cached = 0;
+
+    coalesce_all( );
+}
+
+
+/**
+ * @brief mavalloc_quickfit() without taking the arena lock
+ **/
+int quickfit_unlocked( int lists, int depth )
+{
+    if( lists < 0 || lists > MAVALLOC_QUICKFIT_MAX || depth < 0 ) return -1;
+
+    // Return every cached block to the heap before the lists change
+    quickfit_flush( );
+
+    quick_list_amount = lists;
+    quick_list_depth = depth;
+
+    int i;
+    for( i = 0; i < MAVALLOC_QUICKFIT_MAX; i++ )
+    {
+        quick_lists[ i ].size = 0;
+        quick_lists[ i ].pinned = 0;
+        quick_lists[ i ].uses = 0;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Enable quick-fit lists in front of the heap algorithm
+ *
+ * \param lists The number of exact sizes to cache. 0 disables quick-fit
+ * \param depth The maximum number of blocks cached for each size
+ * \return 0 on success. -1 if the values are out of range
+ **/
+int mavalloc_quickfit( int lists, int depth )
+{
+    ARENA_LOCK( );
+    int result = quickfit_unlocked( lists, depth );
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+/**
+ * @brief Reserve a quick-fit list for an exact size
+ *
+ * \param size The size to cache, rounded to its size class
+ * \return 0 on success. -1 if every list is already reserved
+ **/
+int mavalloc_quickfit_size( size_t size )
+{
+    size_t requested_size = round_size( size );
+    int i;
+
+    // Pin an existing list for this size, or claim one that is not pinned
+    for( i = 0; i < quick_list_amount; i++ )
+    {
+        if( quick_lists[ i ].size == requested_size ) break;
+    }
+
+    if( i == quick_list_amount )
+    {
+        for( i = 0; i < quick_list_amount; i++ )
+        {
+            if( !quick_lists[ i ].pinned && quick_lists[ i ].count == 0 ) break;
+        }
+    }
+
+    if( i == quick_list_amount ) return -1;
+
+    quick_lists[ i ].size = requested_size;
+    quick_lists[ i ].pinned = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Pops a cached block of an exact size
+ *
+ * \param size The requested size
+ * \return void * of the cached block on success. NULL on a miss
+ **/
+void * quickfit_pop( size_t size )
+{
+    int i;
+
+    for( i = 0; i < quick_list_amount; i++ )
+    {
+        struct QuickList * list = &quick_lists[ i ];
+
+        if( list->size != size || list->top == NULL ) continue;
+
+        struct Node * node = list->top;
+
+        list->top = node->quick_next;
+        list->count--;
+        list->uses++;
+        quick_cached--;
+        quick_pops++;
+
+        node->type = PROCESS;
+        node->serial = txn_serial;
+        used_bytes = used_bytes + node->size;
+
+        return memory_arena + node->address;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Parks a freed block on the quick-fit list for its size
+ *
+ * Sizes that are not pinned are learned: a block whose size has no list
+ * takes over an empty list that has not been used since the counters 
+ * were last halved.
+ *
+ * \param node The process node being freed
+ * \return 1 if the block was cached. 0 if it must be freed normally
+ **/
+int quickfit_push( struct Node * node )
+{
+    struct QuickList * list = NULL;
+    int i;
+
+    // Age the use counters so sizes that stop showing up can be replaced
+    if( ++quick_frees >= QUICKFIT_DECAY )
+    {
+        quick_frees = 0;
+        for( i = 0; i < quick_list_amount; i++ ) quick_lists[ i ].uses /= 2;
+    }
+
+    for( i = 0; i < quick_list_amount; i++ )
+    {
+        if( quick_lists[ i ].size == node->size )
+        {
+            list = &quick_lists[ i ];
+            break;
+        }
+    }
+
+    if( list == NULL )
+    {
+        for( i = 0; i < quick_list_amount; i++ )
+        {
+            struct QuickList * candidate = &quick_lists[ i ];
+
+            if( !candidate->pinned && candidate->count == 0 && candidate->uses == 0 )
+            {
+                list = candidate;
+                list->size = node->size;
+                break;
+            }
+        }
+    }
+
+    // No list for this size or the list is full
+    if( list == NULL || list->count >= quick_list_depth ) return 0;
+
+    node->type = CACHED;
+    node->quick_next = list->top;
+    used_bytes = used_bytes - node->size;
+
+    list->top = node;
+    list->count++;
+    list->uses++;
+    quick_cached++;
+
+    return 1;
+}
+
+// Requests of at least this many bytes get their own mapping instead of 
+// a block in the arena. 0 disables direct mapping
+size_t mmap_threshold;
+
+// Open addressing hash table of direct mappings keyed by address
+struct DirectMap
+{
+    void * address;
+    size_t length;
+};
+
+struct DirectMap * direct_maps;
+
+// Number of slots in the direct mapping table, always a power of two
+size_t direct_map_capacity;
+
+// Number of live direct mappings
+size_t direct_map_count;
+
+/**
+ * @brief Set the direct mapping threshold
+ *
+ * Requests of at least this many bytes (after rounding) are served by 
+ * their own anonymous mapping instead of a block in the arena, so a 
+ * single huge block can not fragment the arena. mavalloc_free unmaps 
+ * them and returns the memory to the OS at once. Direct mappings are 
+ * not counted by mavalloc_size. The default of 0 disables direct mapping.
+ *
+ * \param threshold The smallest request served by its own mapping. 0 disables it
+ * \return None
+ **/
+void mavalloc_set_mmap_threshold( size_t threshold )
+{
+    mmap_threshold = threshold;
+}
+
+/**
+ * @brief Returns the home slot of an address in the direct mapping table
+ *
+ * \param address The start of a mapping
+ * \return The index of the first slot to probe
+ **/
+size_t direct_map_slot( void * address )
+{
+    // Mappings are page aligned so the low bits carry no information
+    uint64_t key = (uint64_t)(uintptr_t)address >> 12;
+
+    return (size_t)( ( key * 0x9E3779B97F4A7C15ULL ) >> 32 ) & ( direct_map_capacity - 1 );
+}
+
+/**
+ * @brief Inserts a mapping into the direct mapping table
+ *
+ * The table doubles once it is half full.
+ *
+ * \param address The start of the mapping
+ * \param length The length of the mapping in bytes
+ * \return 0 on success. -1 if the table could not grow
+ **/
+int direct_map_insert( void * address, size_t length )
+{
+    if( ( direct_map_count + 1 ) * 2 > direct_map_capacity )
+    {
+        struct DirectMap * old = direct_maps;
+        size_t old_capacity = direct_map_capacity;
+        size_t capacity = old_capacity ? old_capacity * 2 : 16;
+
+        struct DirectMap * table = (struct DirectMap *)calloc( capacity, sizeof( struct DirectMap ) );
+        if( table == NULL ) return -1;
+
+        direct_maps = table;
+        direct_map_capacity = capacity;
+        direct_map_count = 0;
+
+        size_t i;
+        for( i = 0; i < old_capacity; i++ )
+        {
+            if( old[ i ].address != NULL ) direct_map_insert( old[ i ].address, old[ i ].length );
+        }
+
+        free( old );
+    }
+
+    size_t slot = direct_map_slot( address );
+
+    while( direct_maps[ slot ].address != NULL ) slot = ( slot + 1 ) & ( direct_map_capacity - 1 );
+
+    direct_maps[ slot ].address = address;
+    direct_maps[ slot ].length = length;
+    direct_map_count++;
+
+    return 0;
+}
+
+/**
+ * @brief Removes a mapping from the direct mapping table
+ *
+ * Later entries of the probe run are shifted back so lookups never need
+ * tombstones.
+ *
+ * \param address The start of the mapping
+ * \return The length of the mapping. 0 if the address is not mapped
+ **/
+size_t direct_map_remove( void * address )
+{
+    if( direct_map_count == 0 ) return 0;
+
+    size_t mask = direct_map_capacity - 1;
+    size_t slot = direct_map_slot( address );
+
+    while( direct_maps[ slot ].address != address )
+    {
+        if( direct_maps[ slot ].address == NULL ) return 0;
+        slot = ( slot + 1 ) & mask;
+    }
+
+    size_t length = direct_maps[ slot ].length;
+    size_t hole = slot;
+
+    // Move back any entry whose home slot is not between the hole and itself
+    for( slot = ( hole + 1 ) & mask; direct_maps[ slot ].address != NULL; slot = ( slot + 1 ) & mask )
+    {
+        size_t home = direct_map_slot( direct_maps[ slot ].address );
+
+        if( ( ( slot - home ) & mask ) >= ( ( slot - hole ) & mask ) )
+        {
+            direct_maps[ hole ] = direct_maps[ slot ];
+            hole = slot;
+        }
+    }
+
+    direct_maps[ hole ].address = NULL;
+    direct_maps[ hole ].length = 0;
+    direct_map_count--;
+
+    return length;
+}
+
+/**
+ * @brief Serves a large request with its own mapping
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of the mapping on success. NULL on failure
+ **/
+void * alloc_direct( size_t size )
+{
+    size_t page = (size_t)sysconf( _SC_PAGESIZE );
+    size_t length = ( size + page - 1 ) & ~( page - 1 );
+
+    void * address = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+    if( address == MAP_FAILED ) return NULL;
+
+    if( direct_map_insert( address, length ) )
+    {
+        munmap( address, length );
+        return NULL;
+    }
+
+    stats.direct_mapped_blocks++;
+    stats.direct_mapped_bytes = stats.direct_mapped_bytes + length;
+    used_bytes = used_bytes + length;
+
+    return address;
+}
+
+/**
+ * @brief Unmaps a block served by alloc_direct()
+ *
+ * \param ptr The start of the mapping
+ * \return 1 if the mapping was unmapped. 0 if the pointer is not mapped
+ **/
+int free_direct( void * ptr )
+{
+    size_t length = direct_map_remove( ptr );
+
+    // Ignore pointers that were never mapped
+    if( length == 0 ) return 0;
+
+    munmap( ptr, length );
+
+    stats.direct_mapped_blocks--;
+    stats.direct_mapped_bytes = stats.direct_mapped_bytes - length;
+    used_bytes = used_bytes - length;
+
+    return 1;
+}
+
+/**
+ * @brief Unmaps every direct mapping and releases the table
+ *
+ * \return None
+ **/
+void direct_map_destroy( )
+{
+    size_t i;
+
+    for( i = 0; i < direct_map_capacity; i++ )
+    {
+        if( direct_maps[ i ].address != NULL ) munmap( direct_maps[ i ].address, direct_maps[ i ].length );
+    }
+
+    free( direct_maps );
+
+    direct_maps = NULL;
+    direct_map_capacity = 0;
+    direct_map_count = 0;
+}
+
+
+// Size of the virtual range mavalloc_init() reserves for the arena.
+// 0 allocates a fixed arena with malloc()
+size_t reserve_size;
+
+// Length of the reserved range backing the current arena. 0 if the 
+// arena came from malloc()
+size_t arena_reserved;
+
+// Number of bytes at the start of the reserved range that are readable 
+// and writable. Always a multiple of the page size
+size_t arena_committed;
+
+// Bytes added by the last growth of the arena. 0 if it has not grown
+size_t arena_grow_step;
+
+/**
+ * @brief Set the virtual range reserved for the arena
+ *
+ * When the reserve is larger than the size given to mavalloc_init, the 
+ * arena is backed by a reserved range of address space instead of 
+ * malloc. Only the pages covering the initial size are committed, and 
+ * more pages are committed whenever an allocation does not fit, so the 
+ * arena grows in place and its holes keep coalescing across the whole 
+ * range. Growth applies to every algorithm except RING. The reserve 
+ * takes effect on the next call to mavalloc_init. The default of 0 
+ * allocates a fixed arena with malloc.
+ *
+ * \param reserve The number of bytes of address space to reserve. 0 disables it
+ * \return None
+ **/
+void mavalloc_set_reserve( size_t reserve )
+{
+    reserve_size = reserve;
+}
+
+/**
+ * @brief Rounds a size up to a whole number of pages
+ *
+ * \param size The size in bytes
+ * \return The page rounded size
+ **/
+size_t page_round( size_t size )
+{
+    size_t page = (size_t)sysconf( _SC_PAGESIZE );
+
+    return ( size + page - 1 ) & ~( page - 1 );
+}
+
+/**
+ * @brief Allocates the memory arena
+ *
+ * When a reserve is set the whole range is mapped without access and 
+ * only the pages covering the initial size are committed. Otherwise the 
+ * arena comes from malloc().
+ *
+ * \param size The initial size of the arena in bytes
+ * \return 0 on success. -1 on failure
+ **/
+int arena_map( size_t size )
+{
+    arena_reserved = 0;
+    arena_committed = 0;
+    arena_grow_step = 0;
+
+    if( reserve_size <= size )
+    {
+        // Start the arena on a cache line so blocks that are a whole 
+        // number of lines long stay line aligned. The arena is still 
+        // released with free()
+        if( posix_memalign( &memory_arena, MAVALLOC_CACHE_LINE, size ) )
+        {
+            memory_arena = NULL;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    size_t reserved = page_round( reserve_size );
+
+    memory_arena = mmap( NULL, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+
+    if( memory_arena == MAP_FAILED )
+    {
+        memory_arena = NULL;
+        return -1;
+    }
+
+    arena_reserved = reserved;
+    arena_committed = page_round( size );
+
+    if( mprotect( memory_arena, arena_committed, PROT_READ | PROT_WRITE ) )
+    {
+        munmap( memory_arena, arena_reserved );
+        memory_arena = NULL;
+        arena_reserved = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Releases the memory arena
+ *
+ * \return None
+ **/
+void arena_unmap( )
+{
+    if( arena_reserved > 0 ) munmap( memory_arena, arena_reserved );
+    else                     free( memory_arena );
+
+    memory_arena = NULL;
+    arena_reserved = 0;
+    arena_committed = 0;
+}
+
+/**
+ * @brief Grows a reserved arena in place
+ *
+ * Commits enough pages past the end of the arena to fit the request 
+ * and adds them to the trailing hole, so they coalesce with the space 
+ * already free at the end. Each step grows the arena by at least an 
+ * eighth to keep the number of mprotect() calls down.
+ *
+ * \param size The size of the request that did not fit
+ * \return 0 on success. -1 if the arena can not grow
+ **/
+int arena_grow( size_t size )
+{
+    // Only reserved arenas can grow, and the RING buffer can not move its wrap point
+    if( arena_reserved == 0 || heap_algo == RING ) return -1;
+
+    struct Node * last = head_pointer;
+    size_t tail_free = 0;
+
+    if( uses_node_list( heap_algo ) )
+    {
+        while( last->next != NULL ) last = last->next;
+
+        // Space already free at the end of the arena counts towards the request
+        if( last != head_pointer && last->type == HOLE ) tail_free = last->size;
+    }
+
+    // The request would have fit, something else made it fail
+    if( tail_free >= size ) return -1;
+
+    size_t growth = size - tail_free;
+    if( growth < memory_arena_size / 8 ) growth = memory_arena_size / 8;
+
+    size_t new_size = page_round( memory_arena_size + growth );
+    if( new_size > arena_reserved ) new_size = arena_reserved;
+
+    if( new_size - memory_arena_size < size - tail_free ) return -1;
+
+    // Commit the new pages
+    if( new_size > arena_committed )
+    {
+        if( mprotect( memory_arena + arena_committed, new_size - arena_committed, PROT_READ | PROT_WRITE ) ) return -1;
+
+        arena_committed = new_size;
+    }
+
+    size_t added = new_size - memory_arena_size;
+    arena_grow_step = added;
+
+    if( heap_algo == BITMAP )
+    {
+        bitmap_grow( new_size );
+    }
+    else if( tail_free > 0 )
+    {
+        last->size = last->size + added;
+        hole_index_update( last );
+    }
+    else
+    {
+        // The arena ends with a process node, so append a hole
+        struct Node * hole = new_node( HOLE, memory_arena_size, added );
+
+        // If new_node() fails, new_node() returns a NULL pointer
+        if( hole == NULL ) return -1;
+
+        last->next = hole;
+        hole_index_add( hole );
+    }
+
+    memory_arena_size = new_size;
+
+    return 0;
+}
+
+
+/**
+ * @brief Starts a new ADAPTIVE sampling window
+ *
+ * \param algorithm The fit policy to run until the next switch
+ * \return None
+ **/
+void adaptive_reset( enum ALGORITHM algorithm )
+{
+    adaptive_algo = algorithm;
+    adaptive_candidate = algorithm;
+    adaptive_streak = 0;
+    adaptive_allocations = 0;
+    adaptive_failures = 0;
+    adaptive_steps = 0;
+}
+
+
+/**
+ * @brief Initialize the allocation arena and set the algorithm type
+ *
+ * This function takes the provided size and calls malloc to allocate a 
+ * memory arena. The size must be aligned to a word boundary.
+ * 
+ * If the allocation succeeds it returns 0. If the allocation fails or the 
+ * size is less than 0 the function returns -1
+ *
+ * \param size The size of the pool to allocate in bytes
+ * \param algorithm The heap algorithm to implement
+ * \return 0 on success. -1 on failure
+ **/
+int mavalloc_init( size_t size, enum ALGORITHM algorithm )
+{
+    if ( size < 0 ) return -1;
+    
+    // 4 byte word align size
+    size_t requested_size = ALIGN4( size );
+
+    // Allocate the memory arena, or reserve room for it to grow into
+    if( arena_map( requested_size ) ) return -1;
+
+    // Sets size of the memory arena
+    memory_arena_size = requested_size;
+
+    // Initialize node stack
+    node_stack_init( NODE_AMOUNT );
+
+    // Sets current algorithm
+    heap_algo = algorithm;
+
+    // Start counting from a clean slate
+    memset( &stats, 0, sizeof( stats ) );
+    used_bytes = 0;
+    pressure_signalled = 0;
+
+    // ADAPTIVE starts out with first fit
+    adaptive_reset( FIRST_FIT );
+
+    // The BITMAP algorithm tracks the arena with its own maps
+    if( heap_algo == BITMAP && bitmap_init( requested_size, arena_reserved ) )
+    {
+        free( node_stack );
+        arena_unmap( );
+        stack_head = NULL;
+        return -1;
+    }
+
+    // Start the RING buffer empty
+    ring_head = 0;
+    ring_tail = 0;
+    ring_blocks = 0;
+    ring_pushed = 0;
+
+    // Transactions do not outlive the arena
+    txn_depth = 0;
+    txn_log_length = 0;
+
+    // Neither do retired blocks
+    retire_lists[ 0 ] = NULL;
+    retire_lists[ 1 ] = NULL;
+    retire_lists[ 2 ] = NULL;
+    retire_pending = 0;
+
+    // Initiate the head pointer, used in triple reference technique
+    head_pointer = new_node( HOLE, 0, 0 );
+
+    // If new_node() fails, new_node() returns a NULL pointer
+    if ( head_pointer == NULL ) return -1;
+
+    // Coloring starts over with the first color
+    color_next = 0;
+
+    // Initiate hole type head node (first node in linked list)
+    head_pointer->next = new_node( HOLE, 0, requested_size );
+
+    // If new_node() fails, new_node() returns a NULL pointer
+    if ( head_pointer->next == NULL ) return -1;
+
+    // Index the first hole
+    hole_root = NULL;
+    hole_index_add( head_pointer->next );
+
+    // Set the initial previous node to the head node
+    previous_node = head_pointer;
+
+    arena_generation++;
+
+    return 0;
+}
+
+
+/**
+ * @brief Number of arenas set up so far
+ *
+ * Every successful mavalloc_init starts a new generation. Caches that 
+ * keep freed blocks outside the allocator compare it with the 
+ * generation they were filled in, so they never hand out blocks of an 
+ * arena that was destroyed.
+ *
+ * \return The generation of the current arena
+ **/
+unsigned int mavalloc_generation( )
+{
+    return arena_generation;
+}
+
+
+/**
+ * @brief Destroy the arena
+ *
+ * This function releases all allocated memory.
+ * First it frees all the nodes in the linked link.
+ * Then it frees the memory arena.
+ *
+ * \return None 
+ **/
+void mavalloc_destroy( )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return;
+
+    // Starting from the pointer to the head of the linked list, 
+    // free all nodes in the linked list
+    //struct Node * runner = head_pointer;
+    //struct Node * node;
+
+    //while( runner != NULL ) 
+    //{
+    //    node = runner;
+    //    runner = runner->next;
+    //    node_free( node );
+    //}
+
+    // The maintenance thread must not touch the arena being released
+    mavalloc_maintenance_stop( );
+
+    // Forget the cached blocks, their nodes are released below
+    quickfit_flush( );
+
+    // Free the all the nodes allocated in the node_stack array
+    free( node_stack );
+
+    // Unmap the large blocks that bypassed the arena
+    direct_map_destroy( );
+
+    // Free the BITMAP maps
+    bitmap_destroy( );
+
+    // Free the transaction log
+    free( txn_log );
+    txn_log = NULL;
+    txn_log_length = 0;
+    txn_log_capacity = 0;
+    txn_depth = 0;
+
+    // Free the memory arena
+    arena_unmap( );
+    used_bytes = 0;
+
+    // Remove access to linked list address
+    head_pointer = NULL;
+
+    // Remove access to the hole index
+    hole_root = NULL;
+
+    // Remove access to previous node pointer
+    previous_node = NULL;
+
+    // Remove access to the stack head
+    stack_head = NULL;
+
+    return;
+}
+
+/**
+ * @brief Configure cache coloring of large blocks
+ *
+ * Blocks of MAVALLOC_COLOR_MIN_SIZE bytes or more that are split from 
+ * the start of a hole are pushed forward by a rotating multiple of the 
+ * stride: 0, stride, 2 * stride and so on up to colors - 1 strides. 
+ * Equally sized large blocks then start at different cache set offsets 
+ * instead of all conflicting in the same sets. The bytes skipped stay 
+ * a hole in front of the block, so they merge back when it is freed. 
+ * A hole that can not fit the offset hands out its start as usual and 
+ * keeps the color for the next block. Offsets below the split threshold 
+ * are passed over, since they would only leave sliver holes. 
+ * Coloring applies to the node list algorithms and is off by default.
+ *
+ * \param stride The color step in bytes, normally the cache line size. 0 disables coloring
+ * \param colors The number of offsets to rotate through
+ * \return 0 on success. -1 if the values are out of range
+ **/
+int mavalloc_set_coloring( size_t stride, int colors )
+{
+    if( stride > 0 && colors < 1 ) return -1;
+
+    // Offsets must keep blocks word aligned
+    if( stride != ALIGN4( stride ) ) return -1;
+
+    color_stride = stride;
+    color_count = colors;
+    color_next = 0;
+
+    return 0;
+}
+
+
+/**
+ * @brief Get the cache color stride
+ *
+ * \return The color step in bytes. 0 when coloring is off
+ **/
+size_t mavalloc_get_color_stride( )
+{
+    return color_stride;
+}
+
+
+/**
+ * @brief Allocates space at the start of a hole
+ *
+ * The hole node becomes the process node and the remaining space, if 
+ * any, moves to a new hole node right after it.
+ *
+ * \param hole The hole node containing the space to be allocated
+ * \param size The number of bytes that will be allocated from the hole node
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * allocate_hole( struct Node * hole, size_t size )
+{
+    // Fails if hole doesn't exist
+    if( hole == NULL ) return NULL;
+
+    // The hole left in front of a colored block, if any
+    struct Node * front = NULL;
+
+    // Push large blocks to the next cache color, leaving the offset as a 
+    // hole in front of them
+    if( color_stride > 0 && size >= MAVALLOC_COLOR_MIN_SIZE )
+    {
+        size_t offset = color_stride * color_next;
+
+        // An offset below the split threshold would only leave a sliver 
+        // hole, so that color is passed over
+        int sliver = ( offset > 0 && offset < split_threshold );
+        int fits = ( hole->size - size >= offset );
+
+        if( offset > 0 && !sliver && fits )
+        {
+            struct Node * block = new_node( HOLE, hole->address + offset, hole->size - offset );
+
+            // If new_node() fails, new_node() returns NULL
+            if( block == NULL ) return NULL;
+
+            block->next = hole->next;
+            block->purged = hole->purged;
+            hole->next = block;
+
+            hole->size = offset;
+            hole_index_update( hole );
+            hole_index_add( block );
+
+            stats.colored_allocations++;
+            stats.color_offset_bytes = stats.color_offset_bytes + offset;
+
+            front = hole;
+            hole = block;
+        }
+
+        // A hole that can not fit the offset keeps the color for the next block
+        if( sliver || fits ) color_next = ( color_next + 1 ) % color_count;
+    }
+
+    size_t remainder = hole->size - size;
+
+    // If nothing useful would be left over, hand out the whole hole.
+    // This avoids sliver holes that can never be reused but still take 
+    // a node and lengthen every walk of the linked list
+    if( remainder == 0 || remainder < split_threshold )
+    {
+        if( remainder > 0 )
+        {
+            stats.unsplit_allocations++;
+            stats.unsplit_slack_bytes = stats.unsplit_slack_bytes + remainder;
+        }
+
+        hole_index_remove( hole );
+        hole->type = PROCESS;
+        hole->serial = txn_serial;
+        used_bytes = used_bytes + hole->size;
+
+        return memory_arena + hole->address;
+    }
+
+    // Split the hole node into a process node and a hole node
+    // Process node will have the requested size
+    // Hole node will contain the remaining space
+
+    // First create the new hole node after the requested space
+    struct Node * rest = new_node( HOLE, hole->address + size, remainder );
+
+    // If new_node() fails, merge the color offset back so the hole is 
+    // left as it was found
+    if( rest == NULL )
+    {
+        if( front != NULL )
+        {
+            color_next = ( color_next + color_count - 1 ) % color_count;
+            stats.colored_allocations--;
+            stats.color_offset_bytes = stats.color_offset_bytes - front->size;
+
+            hole_index_remove( hole );
+
+            front->size = front->size + hole->size;
+            front->next = hole->next;
+            if( previous_node == hole ) previous_node = front;
+            node_free( hole );
+
+            hole_index_update( front );
+        }
+
+        return NULL;
+    }
+
+    hole_index_remove( hole );
+
+    // Turn the old hole into the process node
+    hole->type = PROCESS;
+    hole->size = size;
+    hole->serial = txn_serial;
+    used_bytes = used_bytes + size;
+
+    // Link the remaining space in after the process node
+    rest->next = hole->next;
+    rest->purged = hole->purged;
+    hole->next = rest;
+
+    hole_index_add( rest );
+
+    //Return allocated memory arena address
+    return memory_arena + hole->address;
+}
+
+
+/**
+ * @brief Allocates space at the end of a hole
+ *
+ * The hole keeps its start and shrinks, and a new process node is 
+ * linked in after it for the top of the hole.
+ *
+ * \param hole The hole node containing the space to be allocated
+ * \param size The number of bytes that will be allocated from the hole node
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * allocate_hole_top( struct Node * hole, size_t size )
+{
+    // Fails if hole doesn't exist
+    if( hole == NULL ) return NULL;
+
+    size_t remainder = hole->size - size;
+
+    // Without a useful remainder this is the same as allocating from the start
+    if( remainder == 0 || remainder < split_threshold ) return allocate_hole( hole, size );
+
+    struct Node * process = new_node( PROCESS, hole->address + remainder, size );
+
+    // If new_node() fails, new_node() returns NULL
+    if( process == NULL ) return NULL;
+
+    process->next = hole->next;
+    hole->next = process;
+    used_bytes = used_bytes + size;
+
+    hole->size = remainder;
+    hole_index_update( hole );
+
+    return memory_arena + process->address;
+}
+
+
+/**
+ * @brief Allocates a node of a specified size at the specified hole
+ *
+ * \param hole_ptr The node pointing to the hole node containing the space to be allocated
+ * \param size The number of bytes that will be allocated from the hole node
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * allocate_node( struct Node * hole_ptr , size_t size )
+{
+    // Fails if hole pointer doesn't exist
+    if( hole_ptr == NULL ) return NULL;
+
+    return allocate_hole( hole_ptr->next, size );
+}
+
+
+/**
+ * @brief First fit heap allocation algorithm
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_first_fit( size_t size ) 
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return NULL;
+
+    // The Cartesian tree finds the lowest fitting hole without a full walk
+    if( hole_index == HOLE_INDEX_CARTESIAN ) return allocate_hole( tree_first_fit( size ), size );
+
+    // Starting from the head of the linked list, 
+    // find the first hole that is large enough for the requested size
+    struct Node * runner = head_pointer;  // Head pointer points to head node
+
+    while( runner->next->type != HOLE || runner->next->size < size )
+    {
+        runner = runner->next;
+        stats.search_steps++;
+
+        // The end of the linked list has been reached
+        // There are no eligible holes left
+        if( runner->next == NULL ) return NULL;
+    }
+
+    // runner->next is now the hole node with the available space
+    // runner points to the hole node
+    return allocate_node( runner, size );
+}
+
+
+/**
+ * @brief Next fit heap allocation algorithm
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_next_fit( size_t size )
+{
+    // check if the linked list exists
+    if ( head_pointer == NULL ) return NULL;
+
+    // starting from the previous node in the linked list,
+    // find the next hole that is large enough for the requested size
+    // If the previous node ended up at the end of the linked list, start over from the head
+    if( previous_node->next == NULL ) previous_node = head_pointer;
+
+    struct Node * runner = previous_node; // runner pointer points to node previously left off on
+
+    while ( runner->next->type != HOLE || runner->next->size < size )
+    {
+        runner = runner->next;
+        stats.search_steps++;
+
+        // If end of the linked list is hit, loop back to the head
+        if( runner->next == NULL ) runner = head_pointer;
+
+        // The linked list has been completely looped and is back to where it started
+        // There are no eligible holes left
+        if( runner == previous_node ) return NULL;
+    }
+
+    // Update the previous node to the hole node with the available space
+    previous_node = runner;
+
+    // runner->next is now the hole node with the available space
+    // runner points to the hole node
+    return allocate_node( runner, size );
+}
+
+/**
+ * @brief Best fit heap allocation algorithm
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_best_fit( size_t size )
+{
+    // check if the linked list exists
+    if ( head_pointer == NULL ) return NULL;
+
+    // The Cartesian tree finds a small fitting hole down a single path
+    if( hole_index == HOLE_INDEX_CARTESIAN ) return allocate_hole( tree_better_fit( size ), size );
+
+    struct Node * best_hole_ptr = NULL;
+    size_t min = memory_arena_size+1;
+
+    // Iterate through the linked list
+    // Store the smallest eligible hole into best_hole_ptr
+    struct Node * runner = head_pointer;
+
+    while( runner->next != NULL )
+    {
+        if( runner->next->type == HOLE && runner->next->size >= size && runner->next->size < min )
+        {
+            min = runner->next->size;
+            best_hole_ptr = runner;
+        }
+
+        runner = runner->next;
+        stats.search_steps++;
+    }
+
+    // best_hole_ptr now points to the hole that will be used to allocate memory in the memory arena
+    return allocate_node( best_hole_ptr, size );
+}
+
+/**
+ * @brief Worst fit heap allocation algorithm
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_worst_fit( size_t size )
+{
+    // Check if the linked list exists
+    if( head_pointer == NULL ) return NULL;
+
+    // The root of the Cartesian tree is the largest hole
+    if( hole_index == HOLE_INDEX_CARTESIAN )
+    {
+        if( hole_root == NULL || hole_root->size < size ) return NULL;
+        return allocate_hole( hole_root, size );
+    }
+
+    struct Node * worst_hole_ptr = NULL;
+    size_t max = 0;
+
+    // Iterate through the linked list
+    // Store the largest eligible hole into worst_hole_ptr
+    struct Node * runner = head_pointer;
+
+    while( runner->next != NULL )
+    {
+        if( runner->next->type == HOLE && runner->next->size >= size && runner->next->size > max )
+        {
+            max = runner->next->size;
+            worst_hole_ptr = runner;
+        }
+
+        runner = runner->next;
+        stats.search_steps++;
+    }
+
+    // worst_hole_ptr now points to the hole that will be used to allocate memory in the memory arena
+    return allocate_node( worst_hole_ptr, size );
+} 
+
+
+/**
+ * @brief Places a long lived block at the high end of the arena
+ *
+ * Takes the highest addressed hole that fits and carves the block from 
+ * its top, so long lived blocks pack down from the end of the arena 
+ * while the fit algorithms fill short lived blocks up from the start.
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_high( size_t size )
+{
+    // Check if the linked list exists
+    if( head_pointer == NULL ) return NULL;
+
+    struct Node * hole = NULL;
+
+    if( hole_index == HOLE_INDEX_CARTESIAN )
+    {
+        // Mirror of the first fit descent, preferring the right subtree
+        struct Node * node = hole_root;
+
+        while( node != NULL && node->size >= size )
+        {
+            stats.search_steps++;
+
+            if( node->right != NULL && node->right->size >= size ) node = node->right;
+            else
+            {
+                hole = node;
+                break;
+            }
+        }
+    }
+    else
+    {
+        struct Node * runner = head_pointer->next;
+
+        while( runner != NULL )
+        {
+            if( runner->type == HOLE && runner->size >= size ) hole = runner;
+
+            runner = runner->next;
+            stats.search_steps++;
+        }
+    }
+
+    return allocate_hole_top( hole, size );
+}
+
+
+/**
+ * @brief Good fit heap allocation algorithm
+ *
+ * Best fit over a bounded number of candidates. The search stops at the 
+ * first hole that fits within good_fit_slack percent of the request, or 
+ * after good_fit_candidates eligible holes, and takes the smallest hole 
+ * seen so far. This caps the length of the walk while staying close to 
+ * best fit.
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_good_fit( size_t size )
+{
+    // Check if the linked list exists
+    if( head_pointer == NULL ) return NULL;
+
+    struct Node * good_hole_ptr = NULL;
+    size_t min = memory_arena_size+1;
+    int candidates = 0;
+
+    // Holes no larger than this are close enough to take at once
+    size_t close_fit = size + size / 100 * good_fit_slack + size % 100 * good_fit_slack / 100;
+
+    struct Node * runner = head_pointer;
+
+    while( runner->next != NULL )
+    {
+        if( runner->next->type == HOLE && runner->next->size >= size )
+        {
+            if( runner->next->size < min )
+            {
+                min = runner->next->size;
+                good_hole_ptr = runner;
+            }
+
+            // The hole that stops the search was looked at, like every 
+            // hole a full best fit walk passes
+            if( runner->next->size <= close_fit )
+            {
+                stats.good_fit_close_fits++;
+                stats.search_steps++;
+                break;
+            }
+
+            if( ++candidates >= good_fit_candidates )
+            {
+                stats.good_fit_bound_hits++;
+                stats.search_steps++;
+                break;
+            }
+        }
+
+        runner = runner->next;
+        stats.search_steps++;
+    }
+
+    // good_hole_ptr now points to the hole that will be used to allocate memory in the memory arena
+    return allocate_node( good_hole_ptr, size );
+}
+
+
+/**
+ * @brief Configure the GOOD_FIT algorithm
+ *
+ * GOOD_FIT is best fit with a bounded search. It takes the first hole 
+ * that is at most slack_percent larger than the request, or the smallest 
+ * of the first candidates eligible holes, whichever comes first. This 
+ * caps the worst case allocation latency while keeping fragmentation 
+ * close to best fit. The statistics count how often each bound stopped 
+ * the search.
+ *
+ * \param candidates The most eligible holes to look at before taking the best one
+ * \param slack_percent How much larger than the request a hole may be and still be taken at once
+ * \return 0 on success. -1 if the values are out of range
+ **/
+int mavalloc_set_good_fit( int candidates, int slack_percent )
+{
+    if( candidates < 1 || slack_percent < 0 ) return -1;
+
+    good_fit_candidates = candidates;
+    good_fit_slack = slack_percent;
+
+    return 0;
+}
+
+
+/**
+ * @brief Runs one of the heap algorithms
+ *
+ * \param algorithm The heap algorithm to run
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_policy( enum ALGORITHM algorithm, size_t size )
+{
+    switch( algorithm ) 
+    {
+        case FIRST_FIT:
+            return alloc_first_fit( size );
+            break; 
+        case NEXT_FIT:
+            return alloc_next_fit( size );
+            break;
+        case BEST_FIT:
+            return alloc_best_fit( size );
+            break;
+        case WORST_FIT:
+            return alloc_worst_fit( size );
+            break;
+        case GOOD_FIT:
+            return alloc_good_fit( size );
+            break;
+        case BITMAP:
+            return alloc_bitmap( size );
+            break;
+        case RING:
+            return alloc_ring( size );
+            break;
+        default:
+            break;
+    }
+
+    // only return NULL on failure
+    return NULL;
+}
+
+
+/**
+ * @brief Picks the fit policy for the next ADAPTIVE window
+ *
+ * Looks at the window that just ended. Frequent failures or free space 
+ * scattered outside the largest hole call for BEST_FIT. Long searches 
+ * call for NEXT_FIT. Otherwise FIRST_FIT is cheap and keeps the low end 
+ * of the arena packed. A new policy has to win ADAPTIVE_HYSTERESIS 
+ * windows in a row before the switch is made.
+ *
+ * \return None
+ **/
+void adaptive_sample( )
+{
+    size_t free_bytes = 0;
+    size_t largest = 0;
+    struct Node * runner = head_pointer->next;
+
+    while( runner != NULL )
+    {
+        if( runner->type == HOLE )
+        {
+            free_bytes = free_bytes + runner->size;
+            if( runner->size > largest ) largest = runner->size;
+        }
+
+        runner = runner->next;
+    }
+
+    enum ALGORITHM candidate = FIRST_FIT;
+
+    if( adaptive_failures * 100 > adaptive_allocations * ADAPTIVE_FAILURE_PERCENT || largest * 2 < free_bytes )
+    {
+        candidate = BEST_FIT;
+    }
+    else if( adaptive_steps > adaptive_allocations * ADAPTIVE_LONG_SEARCH )
+    {
+        candidate = NEXT_FIT;
+    }
+
+    if( candidate == adaptive_algo )
+    {
+        adaptive_streak = 0;
+    }
+    else
+    {
+        if( candidate != adaptive_candidate ) adaptive_streak = 0;
+
+        adaptive_candidate = candidate;
+        adaptive_streak++;
+
+        if( adaptive_streak >= ADAPTIVE_HYSTERESIS )
+        {
+            adaptive_algo = candidate;
+            adaptive_streak = 0;
+            previous_node = head_pointer;
+            stats.algorithm_switches++;
+        }
+    }
+
+    adaptive_allocations = 0;
+    adaptive_failures = 0;
+    adaptive_steps = 0;
+}
+
+
+/**
+ * @brief Adaptive heap allocation algorithm
+ *
+ * Runs the current fit policy and samples its search length and 
+ * failures. Every ADAPTIVE_WINDOW allocations the policy is reviewed.
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_adaptive( size_t size )
+{
+    size_t steps = stats.search_steps;
+
+    void * ptr = alloc_policy( adaptive_algo, size );
+
+    adaptive_steps = adaptive_steps + stats.search_steps - steps;
+    if( ptr == NULL ) adaptive_failures++;
+
+    if( ++adaptive_allocations >= ADAPTIVE_WINDOW ) adaptive_sample( );
+
+    return ptr;
+}
+
+
+/**
+ * @brief Runs the heap algorithm of the arena
+ *
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_algorithm( size_t size )
+{
+    // The ADAPTIVE algorithm runs whichever fit policy it currently prefers
+    if( heap_algo == ADAPTIVE ) return alloc_adaptive( size );
+
+    // Use heap algorithm specified at initialization
+    return alloc_policy( heap_algo, size );
+}
+
+
+/**
+ * @brief Places a block as close as possible to another block
+ *
+ * Walks the address ordered list for the fitting hole nearest to the 
+ * hint. A hole below the hint gives up its top and a hole above the 
+ * hint gives up its start, so the new block lands right next to the 
+ * hint when a hole touches it. The walk stops at the first fitting hole 
+ * past the hint, since every hole after it is further away.
+ *
+ * \param near The address in the arena to allocate close to
+ * \param size The size of space being requested to be allocated
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_near( void * near, size_t size )
+{
+    // Check if the linked list exists
+    if( head_pointer == NULL ) return NULL;
+
+    size_t target = ( char * ) near - ( char * ) memory_arena;
+
+    struct Node * hole = NULL;
+    size_t distance = 0;
+    struct Node * runner = head_pointer->next;
+
+    while( runner != NULL )
+    {
+        stats.search_steps++;
+
+        if( runner->type == HOLE && runner->size >= size )
+        {
+            size_t end = runner->address + runner->size;
+            size_t gap = 0;
+
+            if( end <= target ) gap = target - end;
+            else if( runner->address > target ) gap = runner->address - target;
+
+            if( hole == NULL || gap < distance )
+            {
+                hole = runner;
+                distance = gap;
+            }
+
+            // Holes further along are only further away
+            if( end > target ) break;
+        }
+
+        runner = runner->next;
+    }
+
+    if( hole == NULL ) return NULL;
+
+    void * ptr;
+
+    // Carve from the side of the hole that faces the hint
+    if( hole->address + hole->size <= target ) ptr = allocate_hole_top( hole, size );
+    else ptr = allocate_hole( hole, size );
+
+    if( ptr != NULL )
+    {
+        stats.near_allocations++;
+        stats.near_distance_bytes = stats.near_distance_bytes + distance;
+    }
+
+    return ptr;
+}
+
+
+/**
+ * @brief Picks where a block goes in the arena
+ *
+ * \param size The size of space being requested to be allocated
+ * \param flags The MAVALLOC_HINT flags of the request
+ * \param near The block to allocate close to, or NULL
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_placement( size_t size, int flags, void * near )
+{
+    // Placement hints only apply to the address ordered node list
+    if( uses_node_list( heap_algo ) )
+    {
+        if( near != NULL ) return alloc_near( near, size );
+
+        if( flags & ( MAVALLOC_HINT_LONG | MAVALLOC_HINT_PERMANENT ) ) return alloc_high( size );
+    }
+
+    return alloc_algorithm( size );
+}
+
+
+/**
+ * @brief Finds the node in front of a block
+ *
+ * \param ptr The address of the block in the arena
+ * \return The node pointing to the block node. NULL if no node starts at ptr
+ **/
+struct Node * block_predecessor( void * ptr )
+{
+    struct Node * runner = head_pointer;
+
+    if( runner == NULL || runner->next == NULL ) return NULL;
+
+    // Iterate through the linked list until the address is found
+    while( runner->next->address != ( size_t ) ( ( char * ) ptr - ( char * ) memory_arena ) )
+    {
+        runner = runner->next;
+
+        // The end of the linked list has been reached
+        if( runner->next == NULL ) return NULL;
+    }
+
+    return runner;
+}
+
+
+/**
+ * @brief Turns a process node back into a hole
+ *
+ * The node is combined with the holes on either side of it.
+ *
+ * \param runner The node pointing to the process node
+ * \return None
+ **/
+void release_node( struct Node * runner )
+{
+    struct Node * node;
+
+    // Set when runner is a hole that is already in the hole index
+    int indexed = 0;
+
+    used_bytes = used_bytes - runner->next->size;
+
+    // runner->next is the node to be freed (x)
+    if( runner->type == HOLE && runner != head_pointer ) // Situation c)
+    {
+        node = runner->next;
+        runner->size = runner->size + node->size;
+        runner->next = node->next;
+        if( previous_node == node ) previous_node = runner;
+        node_free( node );
+        indexed = 1;
+    }
+    else // Situation a)
+    {
+        runner = runner->next;
+        runner->type = HOLE;
+    }
+
+    // runner is now the node that has been freed (x or x/a)
+    // If runner is at end of linked list there is nothing to combine after it
+    if( runner->next != NULL && runner->next->type == HOLE ) // Situation b) and d)
+    {
+        node = runner->next;
+        runner->size = runner->size + node->size;
+        runner->next = node->next;
+        if( previous_node == node ) previous_node = runner;
+        hole_index_remove( node );
+        node_free( node );
+    }
+
+    // The freed block still holds its pages
+    runner->purged = 0;
+
+    if( indexed ) hole_index_update( runner );
+    else          hole_index_add( runner );
+}
+
+
+/**
+ * @brief Allocates a block that starts on an alignment boundary
+ *
+ * Takes a block of the requested size first and keeps it if it happens 
+ * to be aligned, which is always the case in an arena where every size 
+ * is a multiple of the alignment. Otherwise the block is given back, a 
+ * block with room for the worst case padding is taken, and the padding 
+ * in front of and behind the aligned part is released as holes.
+ *
+ * \param size The size of space being requested to be allocated
+ * \param flags The MAVALLOC_HINT flags of the request
+ * \param near The block to allocate close to, or NULL
+ * \param align The alignment, a power of two
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_aligned( size_t size, int flags, void * near, size_t align )
+{
+    void * ptr = alloc_placement( size, flags, near );
+
+    if( ptr == NULL || ( ( uintptr_t ) ptr & ( align - 1 ) ) == 0 ) return ptr;
+
+    // Only the node list can give back the misaligned block
+    if( !uses_node_list( heap_algo ) ) return ptr;
+
+    release_node( block_predecessor( ptr ) );
+
+    // Blocks are word aligned, so at most align - 4 bytes of padding are needed
+    size_t span = size + align - 4;
+
+    if( span < size ) return NULL;
+
+    ptr = alloc_placement( span, flags, near );
+
+    if( ptr == NULL ) return NULL;
+
+    struct Node * runner = block_predecessor( ptr );
+    struct Node * node = runner->next;
+
+    size_t pad = ( align - ( ( uintptr_t ) ptr & ( align - 1 ) ) ) & ( align - 1 );
+    size_t tail = node->size - pad - size;
+
+    // Release the bytes behind the aligned part
+    if( tail > 0 )
+    {
+        struct Node * rest = new_node( PROCESS, node->address + pad + size, tail );
+
+        // If new_node() fails the tail stays part of the block
+        if( rest != NULL )
+        {
+            rest->next = node->next;
+            node->next = rest;
+            node->size = node->size - tail;
+
+            release_node( node );
+        }
+    }
+
+    // Release the bytes in front of the aligned part
+    if( pad > 0 )
+    {
+        struct Node * block = new_node( PROCESS, node->address + pad, node->size - pad );
+
+        // If new_node() fails, new_node() returns NULL
+        if( block == NULL )
+        {
+            release_node( runner );
+            return NULL;
+        }
+
+        block->next = node->next;
+        node->next = block;
+        node->size = pad;
+
+        release_node( runner );
+
+        stats.aligned_pad_bytes = stats.aligned_pad_bytes + pad;
+    }
+
+    return ( char * ) ptr + pad;
+}
+
+
+/**
+ * @brief Allocates a block with the placement and alignment of a request
+ *
+ * \param size The size of space being requested to be allocated
+ * \param flags The MAVALLOC_HINT flags of the request
+ * \param near The block to allocate close to, or NULL
+ * \param align The alignment, a power of two. 0 for no alignment
+ * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ **/
+void * alloc_block( size_t size, int flags, void * near, size_t align )
+{
+    if( align > 0 ) return alloc_aligned( size, flags, near, align );
+
+    return alloc_placement( size, flags, near );
+}
+
+
+/**
+ * @brief mavalloc_set_algorithm() without taking the arena lock
+ **/
+int set_algorithm_unlocked( enum ALGORITHM algorithm )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return -1;
+
+    if( !uses_node_list( heap_algo ) || !uses_node_list( algorithm ) ) return -1;
+
+    // ADAPTIVE starts out with the policy that was running
+    if( algorithm == ADAPTIVE && heap_algo != ADAPTIVE ) adaptive_reset( heap_algo );
+
+    heap_algo = algorithm;
+
+    // Next fit starts over from the head
+    previous_node = head_pointer;
+
+    return 0;
+}
+
+
+/**
+ * @brief Switch the heap algorithm at runtime
+ *
+ * FIRST_FIT, NEXT_FIT, BEST_FIT, WORST_FIT, GOOD_FIT and ADAPTIVE all work on 
+ * the same address ordered list of holes, so an arena can move between 
+ * them at any time. BITMAP and RING keep their own structures and can 
+ * only be chosen by mavalloc_init.
+ *
+ * ADAPTIVE samples the search length, failure rate and fragmentation of 
+ * the fit policy it is running and moves between FIRST_FIT, NEXT_FIT 
+ * and BEST_FIT as the workload changes, with hysteresis so it does not 
+ * flip back and forth.
+ *
+ * \param algorithm The heap algorithm to use from now on
+ * \return 0 on success. -1 if the arena can not switch to the algorithm
+ **/
+int mavalloc_set_algorithm( enum ALGORITHM algorithm )
+{
+    ARENA_LOCK( );
+    int result = set_algorithm_unlocked( algorithm );
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+
+/**
+ * @brief Wakes the maintenance thread before its interval is up
+ *
+ * \return None
+ **/
+void maintenance_signal( )
+{
+    maintenance_frees = 0;
+
+    pthread_mutex_lock( &maintenance_mutex );
+    maintenance_wake = 1;
+    pthread_cond_signal( &maintenance_cond );
+    pthread_mutex_unlock( &maintenance_mutex );
+}
+
+
+/**
+ * @brief Frees a block that has no node
+ *
+ * \param ptr The block
+ * \return 1 if the block was freed. 0 if it was not in use
+ **/
+int free_block( void * ptr )
+{
+    if( ptr < memory_arena || ptr >= memory_arena + memory_arena_size ) return free_direct( ptr );
+
+    if( heap_algo == BITMAP ) return free_bitmap( ptr );
+
+    return 0;
+}
+
+
+/**
+ * @brief Orders two block pointers for qsort()
+ *
+ * \param a The first pointer
+ * \param b The second pointer
+ * \return Less than, equal to or greater than 0 as a is below, at or above b
+ **/
+int compare_blocks( const void * a, const void * b )
+{
+    uintptr_t x = ( uintptr_t ) *( void * const * ) a;
+    uintptr_t y = ( uintptr_t ) *( void * const * ) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+
+/**
+ * @brief Reads the link in the first word of a listed block
+ *
+ * Blocks are only word aligned, so the link is copied rather than 
+ * loaded as a pointer.
+ *
+ * \param block The block
+ * \return The next block of the list
+ **/
+void * block_link( void * block )
+{
+    void * next;
+
+    memcpy( &next, block, sizeof( next ) );
+
+    return next;
+}
+
+
+/**
+ * @brief Writes the link in the first word of a listed block
+ *
+ * \param block The block
+ * \param next The next block of the list
+ * \return None
+ **/
+void block_set_link( void * block, void * next )
+{
+    memcpy( block, &next, sizeof( next ) );
+}
+
+
+/**
+ * @brief Sorts a list of blocks linked through their first word
+ *
+ * A merge sort that relinks the blocks in place, so it needs no memory 
+ * beyond its recursion.
+ *
+ * \param list The first block of the list
+ * \return The first block of the list in address order
+ **/
+void * sort_blocks( void * list )
+{
+    if( list == NULL || block_link( list ) == NULL ) return list;
+
+    // Find the middle of the list and cut it in two
+    void * slow = list;
+    void * fast = block_link( list );
+
+    while( fast != NULL && block_link( fast ) != NULL )
+    {
+        slow = block_link( slow );
+        fast = block_link( block_link( fast ) );
+    }
+
+    void * right = block_link( slow );
+    block_set_link( slow, NULL );
+
+    void * left = sort_blocks( list );
+    right = sort_blocks( right );
+
+    void * head = NULL;
+    void * last = NULL;
+
+    while( left != NULL || right != NULL )
+    {
+        void * next;
+
+        if( right == NULL || ( left != NULL && ( uintptr_t ) left < ( uintptr_t ) right ) )
+        {
+            next = left;
+            left = block_link( left );
+        }
+        else
+        {
+            next = right;
+            right = block_link( right );
+        }
+
+        if( last == NULL ) head = next;
+        else block_set_link( last, next );
+
+        last = next;
+    }
+
+    return head;
+}
+
+
+/**
+ * @brief Sorts every retire list in address order
+ *
+ * The order of a retire list does not matter to reclaiming, so it can 
+ * be sorted in place for a walk alongside the arena.
+ *
+ * \return None
+ **/
+void retire_sort( )
+{
+    int i;
+
+    for( i = 0; i < 3; i++ ) retire_lists[ i ] = sort_blocks( retire_lists[ i ] );
+}
+
+
+/**
+ * @brief Checks whether a block is waiting on a retire list
+ *
+ * The retire lists must be sorted, and the blocks asked about must come 
+ * in address order. The cursors start at the heads of the lists and 
+ * only move forward, so a walk over the arena checks every block with 
+ * one pass over the lists.
+ *
+ * \param cursors One position in each retire list
+ * \param ptr The block
+ * \return 1 if the block is retired. 0 if not
+ **/
+int retired_at( void ** cursors, void * ptr )
+{
+    int found = 0;
+    int i;
+
+    for( i = 0; i < 3; i++ )
+    {
+        while( cursors[ i ] != NULL && ( uintptr_t ) cursors[ i ] < ( uintptr_t ) ptr ) cursors[ i ] = block_link( cursors[ i ] );
+
+        if( cursors[ i ] == ptr ) found = 1;
+    }
+
+    return found;
+}
+
+
+/**
+ * @brief Remembers a new block for a transaction rollback
+ *
+ * Node list blocks and RING blocks are found again without the log, so 
+ * only BITMAP blocks and direct mappings are recorded.
+ *
+ * \param ptr The block
+ * \return 1 on success. 0 if the log could not grow
+ **/
+int txn_log_record( void * ptr )
+{
+    int in_arena = ( ptr >= memory_arena && ptr < memory_arena + memory_arena_size );
+
+    if( in_arena && heap_algo != BITMAP ) return 1;
+
+    if( txn_log_length == txn_log_capacity )
+    {
+        size_t capacity = ( txn_log_capacity == 0 ) ? 64 : txn_log_capacity * 2;
+        void ** log = realloc( txn_log, capacity * sizeof( void * ) );
+
+        if( log == NULL ) return 0;
+
+        txn_log = log;
+        txn_log_capacity = capacity;
+    }
+
+    txn_log[ txn_log_length++ ] = ptr;
+
+    return 1;
+}
+
+
+/**
+ * @brief mavalloc_txn_begin() without taking the arena lock
+ **/
+void txn_begin_unlocked( struct mavalloc_txn * txn )
+{
+    if( txn == NULL ) return;
+
+    txn->serial = txn_serial;
+    txn->ring_pushed = ring_pushed;
+    txn->ring_tail = ring_tail;
+    txn->log_length = txn_log_length;
+
+    // Blocks allocated from now on get a larger serial than the mark
+    txn_serial++;
+    txn_depth++;
+}
+
+
+/**
+ * @brief Start a transaction
+ *
+ * Every block allocated from now until the matching commit or rollback 
+ * belongs to the transaction. Transactions can be nested, and rolling 
+ * back an outer transaction also frees the blocks of inner transactions 
+ * that were committed. The mark is shared by the whole arena, not kept 
+ * per thread, so a rollback frees the blocks every thread allocated 
+ * since the mark. Do not use transactions while other threads allocate, 
+ * even with mavalloc_set_thread_safe.
+ *
+ * \param txn Where to save the state to roll back to
+ * \return None
+ **/
+void mavalloc_txn_begin( struct mavalloc_txn * txn )
+{
+    ARENA_LOCK( );
+    txn_begin_unlocked( txn );
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief mavalloc_txn_commit() without taking the arena lock
+ **/
+void txn_commit_unlocked( struct mavalloc_txn * txn )
+{
+    if( txn == NULL || txn_depth == 0 ) return;
+
+    txn_depth--;
+
+    // With no transaction open nothing can be rolled back any more
+    if( txn_depth == 0 ) txn_log_length = 0;
+}
+
+
+/**
+ * @brief Keep the blocks of a transaction
+ *
+ * The blocks stay allocated and are freed one by one as usual.
+ *
+ * \param txn The transaction
+ * \return None
+ **/
+void mavalloc_txn_commit( struct mavalloc_txn * txn )
+{
+    ARENA_LOCK( );
+    txn_commit_unlocked( txn );
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief mavalloc_txn_rollback() without taking the arena lock
+ **/
+size_t txn_rollback_unlocked( struct mavalloc_txn * txn )
+{
+    if( txn == NULL || txn_depth == 0 || head_pointer == NULL ) return 0;
+
+    size_t freed = 0;
+    size_t i;
+
+    // Blocks retired since the mark stay allocated until reclaiming 
+    // frees them, or a reader could see them reused and reclaiming 
+    // would later free whatever took their place
+    void * cursors[ 3 ];
+
+    if( retire_pending > 0 ) retire_sort( );
+
+    memcpy( cursors, retire_lists, sizeof( cursors ) );
+
+    // Free the blocks that have no node, in address order for the retire 
+    // lists. Entries whose block was already freed are skipped by 
+    // free_direct() and free_bitmap()
+    size_t logged = txn_log_length - txn->log_length;
+
+    if( logged > 0 ) qsort( txn_log + txn->log_length, logged, sizeof( void * ), compare_blocks );
+
+    for( i = 0; i < logged; i++ )
+    {
+        void * ptr = txn_log[ txn->log_length + i ];
+
+        if( !retired_at( cursors, ptr ) ) freed = freed + free_block( ptr );
+    }
+
+    txn_log_length = txn->log_length;
+
+    // The walk over the arena starts over at the heads of the lists
+    memcpy( cursors, retire_lists, sizeof( cursors ) );
+
+    if( heap_algo == RING )
+    {
+        // The blocks placed since the mark are the newest in the buffer, 
+        // so the tail moves back to where it was
+        size_t oldest = ring_pushed - ring_blocks;
+        size_t since = ( txn->ring_pushed > oldest ) ? txn->ring_pushed : oldest;
+
+        if( ring_pushed > since )
+        {
+            size_t count = ring_pushed - since;
+            size_t start = ( since == oldest ) ? ring_head : txn->ring_tail;
+            size_t offset = start;
+            size_t previous = start;
+
+            // The tail can only move back to just past the newest retired 
+            // block. Blocks in front of it are released out of order
+            size_t keep = 0;
+            size_t keep_tail = start;
+
+            for( i = 0; i < count; i++ )
+            {
+                size_t header = *ring_header( offset );
+                size_t next = ring_wrap( offset + ( header & ~(size_t)RING_RELEASED ) );
+
+                // Addresses start over where the buffer wraps
+                if( offset < previous ) memcpy( cursors, retire_lists, sizeof( cursors ) );
+                previous = offset;
+
+                if( ( header & RING_RELEASED ) == 0 && retired_at( cursors, memory_arena + offset + RING_HEADER ) )
+                {
+                    keep = i + 1;
+                    keep_tail = next;
+                }
+
+                offset = next;
+            }
+
+            memcpy( cursors, retire_lists, sizeof( cursors ) );
+            offset = start;
+            previous = start;
+
+            // Blocks freed out of order were already taken off the used bytes
+            for( i = 0; i < count; i++ )
+            {
+                size_t header = *ring_header( offset );
+                size_t next = ring_wrap( offset + ( header & ~(size_t)RING_RELEASED ) );
+
+                if( offset < previous ) memcpy( cursors, retire_lists, sizeof( cursors ) );
+                previous = offset;
+
+                if( ( header & RING_RELEASED ) == 0 )
+                {
+                    if( i >= keep )
+                    {
+                        used_bytes = used_bytes - header;
+                    }
+                    else if( !retired_at( cursors, memory_arena + offset + RING_HEADER ) )
+                    {
+                        used_bytes = used_bytes - header;
+                        *ring_header( offset ) = header | RING_RELEASED;
+                        freed++;
+                    }
+                }
+
+                offset = next;
+            }
+
+            size_t rolled = count - keep;
+
+            ring_blocks = ring_blocks - rolled;
+            ring_pushed = ring_pushed - rolled;
+
+            if( keep > 0 ) ring_tail = keep_tail;
+            else ring_tail = ( ring_blocks == 0 ) ? 0 : txn->ring_tail;
+
+            if( ring_blocks == 0 ) ring_head = 0;
+
+            ring_release_front( );
+
+            freed = freed + rolled;
+        }
+    }
+    else if( uses_node_list( heap_algo ) )
+    {
+        // One pass turns the process nodes of the transaction into holes
+        struct Node * runner = head_pointer->next;
+
+        while( runner != NULL )
+        {
+            if( runner->type == PROCESS && runner->serial > txn->serial && !retired_at( cursors, memory_arena + runner->address ) )
+            {
+                runner->type = HOLE;
+                runner->purged = 0;
+                used_bytes = used_bytes - runner->size;
+                freed++;
+            }
+
+            runner = runner->next;
+        }
+
+        // Then a second pass merges them with their neighbours
+        if( quick_cached > 0 ) quickfit_flush( );
+        else coalesce_all( );
+    }
+
+    txn_depth--;
+    if( txn_depth == 0 ) txn_log_length = 0;
+
+    return freed;
+}
+
+
+/**
+ * @brief Free every block allocated since a transaction began
+ *
+ * The node list algorithms stamp every allocated node with a serial, so 
+ * the blocks of the transaction are found and freed in one pass over 
+ * the list followed by one coalescing pass, instead of one search per 
+ * mavalloc_free. RING moves its tail back to where it was when the 
+ * transaction began. BITMAP blocks and direct mappings are recorded 
+ * while a transaction is open and freed from that record. Blocks the 
+ * transaction already freed are skipped. Blocks it retired with 
+ * mavalloc_retire stay allocated until reclaiming frees them, so RING 
+ * only moves its tail back to just past the newest of them.
+ *
+ * \param txn The transaction
+ * \return The number of blocks freed
+ **/
+size_t mavalloc_txn_rollback( struct mavalloc_txn * txn )
+{
+    ARENA_LOCK( );
+    size_t result = txn_rollback_unlocked( txn );
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+
+/**
+ * @brief Calls the pressure callback unless it is already running
+ *
+ * \param level The limit that was reached
+ * \param request The size of the request that reached it
+ * \return None
+ **/
+void pressure_notify( enum MAVALLOC_PRESSURE level, size_t request )
+{
+    if( pressure_callback == NULL || pressure_busy ) return;
+
+    pressure_busy = 1;
+    stats.pressure_callbacks++;
+
+    pressure_callback( level, used_bytes, request, pressure_context );
+
+    pressure_busy = 0;
+}
+
+
+/**
+ * @brief Returns a block that was just placed for a failed request
+ *
+ * The block skips the quick-fit lists and the maintenance count, so the 
+ * arena is left as it was before the block was placed.
+ *
+ * \param ptr The block
+ * \return None
+ **/
+void release_request( void * ptr )
+{
+    int in_arena = ( ptr >= memory_arena && ptr < memory_arena + memory_arena_size );
+
+    if( in_arena && heap_algo == RING )
+    {
+        free_ring( ptr );
+        return;
+    }
+
+    if( !in_arena || heap_algo == BITMAP )
+    {
+        free_block( ptr );
+        return;
+    }
+
+    struct Node * runner = block_predecessor( ptr );
+
+    if( runner != NULL && runner->next->type == PROCESS ) release_node( runner );
+}
+
+
+/**
+ * @brief Finds a place for a rounded request
+ *
+ * Does not check the memory limits, the caller does that once it knows 
+ * how many bytes the block was charged.
+ *
+ * \param requested_size The rounded size of the block
+ * \param flags The MAVALLOC_HINT flags of the request
+ * \param near The block to allocate close to, or NULL
+ * \param align The boundary the block has to start on. 0 for none
+ * \param alignment The alignment asked for by the caller. 0 for none
+ * \return The block on success. NULL on failure
+ **/
+void * place_request( size_t requested_size, int flags, void * near, size_t align, size_t alignment )
+{
+    // Blocks with a placement skip the quick-fit lists
+    int placed = ( near != NULL || align > 0 || ( flags & ( MAVALLOC_HINT_LONG | MAVALLOC_HINT_PERMANENT ) ) );
+
+    void * ptr = NULL;
+
+    // Large requests bypass the arena so they can not fragment it
+    if( mmap_threshold > 0 && requested_size >= mmap_threshold )
+    {
+        ptr = alloc_direct( requested_size );
+    }
+    // A block of exactly this size may be waiting on a quick-fit list
+    else if( quick_list_amount > 0 && uses_node_list( heap_algo ) && !placed )
+    {
+        ptr = quickfit_pop( requested_size );
+    }
+
+    if( ptr == NULL ) ptr = alloc_block( requested_size, flags, near, align );
+
+    // Cached blocks may coalesce into a large enough hole
+    if( ptr == NULL && quick_cached > 0 )
+    {
+        quickfit_flush( );
+        ptr = alloc_block( requested_size, flags, near, align );
+    }
+
+    // A reserved arena can commit more pages and try again
+    if( ptr == NULL && arena_grow( requested_size ) == 0 )
+    {
+        ptr = alloc_block( requested_size, flags, near, align );
+    }
+
+    // BITMAP, RING and direct mappings can not move a block onto a 
+    // boundary, so an explicit alignment they missed fails
+    if( ptr != NULL && alignment > 4 && ( ( uintptr_t ) ptr & ( alignment - 1 ) ) )
+    {
+        release_request( ptr );
+        ptr = NULL;
+    }
+
+    return ptr;
+}
+
+
+/**
+ * @brief alloc_request() without taking the arena lock
+ **/
+void * alloc_request_unlocked( size_t size, int flags, void * near, size_t alignment )
+{
+    // Round the request up to its size class, at least 4 byte word aligned
+    size_t requested_size = round_size( size );
+
+    // Check if linked list exists
+    if( head_pointer == NULL ) return NULL;
+
+    // The size class overflowed
+    if( requested_size == 0 && size > 0 ) return NULL;
+
+    // The alignment must be a power of two
+    if( alignment & ( alignment - 1 ) ) return NULL;
+
+    // Cache line aligned blocks are also a whole number of lines long, 
+    // so no two blocks ever share a line
+    size_t align = 0;
+
+    if( cache_align || ( flags & MAVALLOC_HINT_CACHE_ALIGN ) )
+    {
+        align = MAVALLOC_CACHE_LINE;
+
+        size_t line_size = ( requested_size + align - 1 ) & ~( align - 1 );
+
+        // The size overflowed
+        if( line_size < requested_size ) return NULL;
+
+        requested_size = line_size;
+    }
+
+    // Every block is already word aligned
+    if( alignment > 4 && alignment > align ) align = alignment;
+
+    // The soft limit is reported again after usage fell back under it
+    if( used_bytes <= memory_soft_limit ) pressure_signalled = 0;
+
+    // Set once the callback had its chance during this request
+    int notified = 0;
+
+    // Fail early rather than go past the hard limit, once the callback 
+    // had a chance to free memory
+    if( memory_hard_limit > 0 && used_bytes + requested_size > memory_hard_limit )
+    {
+        pressure_notify( MAVALLOC_PRESSURE_HARD, requested_size );
+        notified = 1;
+
+        if( used_bytes + requested_size > memory_hard_limit )
+        {
+            stats.failed_allocations++;
+            stats.limit_failures++;
+            return NULL;
+        }
+    }
+
+    size_t used_before = used_bytes;
+
+    void * ptr = place_request( requested_size, flags, near, align, alignment );
+
+    // The block can be charged more than was asked for: a hole too small 
+    // to split, whole bitmap units, a ring header or a page rounded 
+    // mapping. A block that went past the hard limit is given back
+    if( ptr != NULL && memory_hard_limit > 0 && used_bytes > memory_hard_limit )
+    {
+        size_t charge = used_bytes - used_before;
+
+        release_request( ptr );
+        ptr = NULL;
+
+        if( !notified )
+        {
+            pressure_notify( MAVALLOC_PRESSURE_HARD, charge );
+
+            // The callback may have freed enough for another try
+            if( used_bytes + charge <= memory_hard_limit )
+            {
+                ptr = place_request( requested_size, flags, near, align, alignment );
+
+                if( ptr != NULL && used_bytes > memory_hard_limit )
+                {
+                    release_request( ptr );
+                    ptr = NULL;
+                }
+            }
+        }
+
+        if( ptr == NULL )
+        {
+            stats.failed_allocations++;
+            stats.limit_failures++;
+            return NULL;
+        }
+    }
+
+    if( ptr == NULL ) stats.failed_allocations++;
+
+    // Count the bytes lost to rounding the request up to its size class
+    if( ptr != NULL )
+    {
+        stats.requested_bytes = stats.requested_bytes + size;
+        stats.rounding_slack_bytes = stats.rounding_slack_bytes + requested_size - size;
+
+        if( flags & MAVALLOC_HINT_SHORT ) stats.short_allocations++;
+        if( flags & MAVALLOC_HINT_LONG ) stats.long_allocations++;
+        if( flags & MAVALLOC_HINT_PERMANENT ) stats.permanent_allocations++;
+
+        // Blocks without a node are remembered for a rollback
+        if( txn_depth > 0 && !txn_log_record( ptr ) )
+        {
+            release_request( ptr );
+            stats.failed_allocations++;
+            return NULL;
+        }
+
+        if( memory_soft_limit > 0 && used_bytes > memory_soft_limit && !pressure_signalled )
+        {
+            pressure_signalled = 1;
+            pressure_notify( MAVALLOC_PRESSURE_SOFT, requested_size );
+        }
+    }
+
+    return ptr;
+}
+
+
+/**
+ * @brief Allocates a block after rounding it to its size class
+ *
+ * Tries the direct mappings, the quick-fit lists and the arena, then 
+ * coalesces cached blocks and grows the arena before giving up.
+ *
+ * \param size The number of bytes being requested
+ * \param flags The MAVALLOC_HINT flags of the request
+ * \param near The block to allocate close to, or NULL
+ * \param alignment The alignment of the block, a power of two. 0 for none
+ * \return void * of address of the allocated space on success. NULL on failure.
+ **/
+void * alloc_request( size_t size, int flags, void * near, size_t alignment )
+{
+    ARENA_LOCK( );
+    void * result = alloc_request_unlocked( size, flags, near, alignment );
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+
+/**
+ * @brief Allocate memory from the arena 
+ *
+ * This function allocated memory from the arena.  The parameter size 
+ * specifies the number of bytes to allocates.  This _must_ be 4 byte aligned using the 
+ * ALIGN4 macro, and is then rounded up to a size class by the policy set 
+ * with mavalloc_set_rounding. 
+ * 
+ * The function searches the arena for a free block using the heap allocation algorithm 
+ * specified when the arena was allocated.
+ *
+ * If there is no available block of memory the function returns NULL
+ *
+ * \return A pointer to the available memory or NULL if no free block is found 
+ **/
+void * mavalloc_alloc( size_t size )
+{
+    return alloc_request( size, 0, NULL, 0 );
+}
+
+
+/**
+ * @brief Allocate memory with a lifetime hint
+ *
+ * Works like mavalloc_alloc. With the node list algorithms, blocks 
+ * hinted MAVALLOC_HINT_LONG or MAVALLOC_HINT_PERMANENT are carved from 
+ * the top of the highest fitting hole, so they collect at the high end 
+ * of the arena. Short lived and unhinted blocks are placed by the heap 
+ * algorithm and fill the arena from the low end. Churn among the short 
+ * lived blocks then leaves holes that merge with each other instead of 
+ * holes pinned between long lived blocks. BITMAP and RING ignore the hint.
+ *
+ * Hinted allocations are counted in the statistics, which also report 
+ * the free bytes, holes and largest hole, so runs with and without 
+ * hints can be compared.
+ *
+ * \param size The number of bytes to allocate
+ * \param flags One of MAVALLOC_HINT_SHORT, MAVALLOC_HINT_LONG or 
+ *              MAVALLOC_HINT_PERMANENT, or 0 for no hint, optionally 
+ *              combined with MAVALLOC_HINT_CACHE_ALIGN
+ * \return A pointer to the available memory or NULL if no free block is found 
+ **/
+void * mavalloc_alloc_hint( size_t size, int flags )
+{
+    return alloc_request( size, flags, NULL, 0 );
+}
+
+
+/**
+ * @brief Allocate memory close to an existing block
+ *
+ * Works like mavalloc_alloc, but with the node list algorithms the block 
+ * goes in the fitting hole nearest by address to hint_ptr, at the end of 
+ * that hole facing hint_ptr. Related objects such as a parent and its 
+ * children then share cache lines and pages. If hint_ptr is NULL or not 
+ * in the arena, or the arena uses BITMAP or RING, the heap algorithm 
+ * places the block as usual.
+ *
+ * \param hint_ptr The block to allocate close to
+ * \param size The number of bytes to allocate
+ * \return A pointer to the available memory or NULL if no free block is found 
+ **/
+void * mavalloc_alloc_near( void * hint_ptr, size_t size )
+{
+    // Only blocks inside the arena can be allocated close to
+    if( hint_ptr != NULL && ( hint_ptr < memory_arena || hint_ptr >= memory_arena + memory_arena_size ) )
+    {
+        hint_ptr = NULL;
+    }
+
+    return alloc_request( size, 0, hint_ptr, 0 );
+}
+
+
+/**
+ * @brief Allocate memory on an alignment boundary
+ *
+ * Works like mavalloc_alloc, but the block starts on a multiple of 
+ * alignment. The node list algorithms carve the block out of a larger 
+ * span and give the bytes around it back as holes. BITMAP and RING can 
+ * only return blocks that happen to be aligned, and direct mappings are 
+ * page aligned. Blocks are freed with mavalloc_free.
+ *
+ * \param size The number of bytes to allocate
+ * \param alignment The alignment, a power of two
+ * \return A pointer to the available memory or NULL if no aligned block is found
+ **/
+void * mavalloc_alloc_aligned( size_t size, size_t alignment )
+{
+    if( alignment == 0 ) return NULL;
+
+    return alloc_request( size, 0, NULL, alignment );
+}
+
+
+/**
+ * @brief mavalloc_free() without taking the arena lock
+ **/
+void free_unlocked( void * ptr )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return;
+
+    // Blocks outside the arena may be direct mappings
+    if( ptr < memory_arena || ptr >= memory_arena + memory_arena_size )
+    {
+        free_direct( ptr );
+        return;
+    }
+
+    // The BITMAP algorithm keeps its own occupancy map
+    if( heap_algo == BITMAP )
+    {
+        free_bitmap( ptr );
+        return;
+    }
+
+    // The RING algorithm keeps its block headers in the arena
+    if( heap_algo == RING )
+    {
+        free_ring( ptr );
+        return;
+    }
+
+    struct Node * runner = block_predecessor( ptr );
+
+    // The block was not found
+    if( runner == NULL ) return;
+
+    // Only process nodes can be freed
+    if( runner->next->type != PROCESS ) return;
+
+    // Enough frees wake the maintenance thread early
+    if( __atomic_load_n( &maintenance_running, __ATOMIC_ACQUIRE ) && ++maintenance_frees >= MAINTENANCE_WAKE_FREES ) maintenance_signal( );
+
+    // Park the block on a quick-fit list instead of coalescing it
+    if( quick_list_amount > 0 && quickfit_push( runner->next ) ) return;
+
+    release_node( runner );
+}
+
+
+/*
+ * \brief free the pointer
+ *
+ * frees the memory block pointed to by pointer. if the block is adjacent
+ * to another block then coalesce (combine) them
+ *
+ * \param ptr the heap memory to free
+ *
+ * \return none
+ */
+void mavalloc_free( void * ptr )
+{
+    ARENA_LOCK( );
+    free_unlocked( ptr );
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief Keep every block on cache lines of its own
+ *
+ * When enabled, every block is rounded up to a multiple of 
+ * MAVALLOC_CACHE_LINE bytes and starts on a cache line boundary, so 
+ * objects handed to different threads never share a line and can not 
+ * false share. Single allocations can ask for the same treatment with 
+ * the MAVALLOC_HINT_CACHE_ALIGN flag of mavalloc_alloc_hint. Alignment 
+ * applies to the node list algorithms. BITMAP and RING only round the 
+ * size. The default is off.
+ *
+ * \param enabled 1 to align every block, 0 to pack blocks on 4 byte words
+ * \return None
+ **/
+void mavalloc_set_cache_align( int enabled )
+{
+    cache_align = enabled;
+}
+
+
+/**
+ * @brief Set the minimum split remainder
+ *
+ * A hole is only split when at least this many bytes would be left in 
+ * the new hole. Otherwise the whole hole is handed out and the extra 
+ * bytes are counted in the statistics. The default of 0 always splits.
+ *
+ * \param threshold The minimum number of bytes worth keeping as a hole
+ * \return None
+ **/
+void mavalloc_set_split_threshold( size_t threshold )
+{
+    split_threshold = threshold;
+}
+
+
+/**
+ * @brief Set the soft and hard memory limits of the arena
+ *
+ * The allocator keeps a running count of the bytes in use, the blocks 
+ * handed out and not yet freed including their rounding, headers and 
+ * direct mappings, so both limits are checked without walking the 
+ * arena. An allocation that takes the count past the soft limit calls 
+ * the pressure callback once, so caches can evict, and the callback is 
+ * armed again when the count falls back under the limit. An allocation 
+ * that would go past the hard limit first calls the callback and then 
+ * fails if there is still no room, even when the arena has space. 
+ * Cached quick-fit blocks are not counted as in use. Child arenas count 
+ * against the arena they are carved from. The limits persist across 
+ * mavalloc_init.
+ *
+ * \param soft_limit The bytes in use that trigger the callback. 0 for none
+ * \param hard_limit The most bytes that may be in use. 0 for none
+ * \return 0 on success. -1 if the soft limit is above the hard limit
+ **/
+int mavalloc_set_limits( size_t soft_limit, size_t hard_limit )
+{
+    if( hard_limit > 0 && soft_limit > hard_limit ) return -1;
+
+    ARENA_LOCK( );
+    memory_soft_limit = soft_limit;
+    memory_hard_limit = hard_limit;
+    ARENA_UNLOCK( );
+
+    return 0;
+}
+
+
+/**
+ * @brief Set the function called when a memory limit is reached
+ *
+ * The callback runs inside the allocation that reached the limit. It 
+ * may free and allocate blocks, and is not called again while it runs.
+ *
+ * \param callback The function to call, or NULL for none
+ * \param context Passed to the callback unchanged
+ * \return None
+ **/
+void mavalloc_set_pressure_callback( mavalloc_pressure_callback callback, void * context )
+{
+    ARENA_LOCK( );
+    pressure_callback = callback;
+    pressure_context = context;
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief Bytes of the blocks in use
+ *
+ * \return The running count compared against the limits
+ **/
+size_t mavalloc_used_bytes( )
+{
+    ARENA_LOCK( );
+    size_t result = used_bytes;
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+
+/**
+ * @brief mavalloc_get_stats() without taking the arena lock
+ **/
+void get_stats_unlocked( struct mavalloc_stats * out )
+{
+    if( out == NULL ) return;
+
+    *out = stats;
+
+    out->used_bytes = used_bytes;
+
+    out->active_algorithm = ( heap_algo == ADAPTIVE ) ? adaptive_algo : heap_algo;
+
+    // Take a snapshot of the holes of the node list arenas
+    out->free_bytes = 0;
+    out->free_holes = 0;
+    out->largest_hole = 0;
+
+    if( head_pointer == NULL || !uses_node_list( heap_algo ) ) return;
+
+    struct Node * runner = head_pointer->next;
+
+    while( runner != NULL )
+    {
+        if( runner->type == HOLE )
+        {
+            out->free_bytes = out->free_bytes + runner->size;
+            out->free_holes++;
+            if( runner->size > out->largest_hole ) out->largest_hole = runner->size;
+        }
+
+        runner = runner->next;
+    }
+}
+
+
+/**
+ * @brief Copy the allocator statistics
+ *
+ * \param out Where to copy the statistics
+ * \return None
+ **/
+void mavalloc_get_stats( struct mavalloc_stats * out )
+{
+    ARENA_LOCK( );
+    get_stats_unlocked( out );
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief Finds where the used part of the BITMAP arena ends
+ *
+ * \return The number of units up to and including the last used unit
+ **/
+size_t bitmap_used_units( )
+{
+    size_t word = ( bitmap_units + 63 ) / 64;
+
+    while( word > 0 )
+    {
+        word--;
+
+        uint64_t used = bitmap_used[ word ];
+
+        // Ignore the padding bits past the last unit
+        size_t valid = bitmap_units - word * 64;
+        if( valid < 64 ) used = used & ( ( 1ULL << valid ) - 1 );
+
+        if( used ) return word * 64 + 64 - __builtin_clzll( used );
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finds where the free space at the end of the arena starts
+ *
+ * \return The offset of the free tail. The arena size if it ends with a block in use
+ **/
+size_t arena_tail_start( )
+{
+    if( heap_algo == BITMAP ) return bitmap_used_units( ) * bitmap_unit;
+
+    if( !uses_node_list( heap_algo ) ) return memory_arena_size;
+
+    struct Node * last = head_pointer->next;
+
+    while( last->next != NULL ) last = last->next;
+
+    return ( last->type == HOLE ) ? last->address : memory_arena_size;
+}
+
+
+/**
+ * @brief mavalloc_trim() without taking the arena lock
+ **/
+size_t trim_unlocked( size_t keep_bytes )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return 0;
+
+    // Only reserved arenas can give pages back without moving
+    if( arena_reserved == 0 || heap_algo == RING ) return 0;
+
+    size_t tail_start;
+    struct Node * before_last = NULL;
+    struct Node * last = NULL;
+
+    if( heap_algo == BITMAP )
+    {
+        tail_start = bitmap_used_units( ) * bitmap_unit;
+    }
+    else
+    {
+        // A cached block at the end of the arena would pin the tail
+        quickfit_flush( );
+
+        before_last = head_pointer;
+        while( before_last->next->next != NULL ) before_last = before_last->next;
+
+        last = before_last->next;
+
+        // Nothing to release if the arena ends with a process node
+        if( last->type != HOLE ) return 0;
+
+        tail_start = last->address;
+    }
+
+    // Keep whole pages so the arena stays committed up to its end, and 
+    // never release the first page so the arena is never empty
+    size_t new_size = page_round( tail_start + keep_bytes );
+    if( new_size == 0 ) new_size = page_round( 1 );
+
+    if( new_size >= memory_arena_size ) return 0;
+
+    // Drop the pages and make them inaccessible again
+    madvise( memory_arena + new_size, arena_committed - new_size, MADV_DONTNEED );
+    mprotect( memory_arena + new_size, arena_committed - new_size, PROT_NONE );
+
+    size_t released = memory_arena_size - new_size;
+
+    if( heap_algo == BITMAP )
+    {
+        size_t units = new_size / bitmap_unit;
+
+        // The released units go back to being padding
+        bitmap_set_range( bitmap_used, units, bitmap_units - units, 1 );
+        bitmap_units = units;
+    }
+    else if( new_size > last->address )
+    {
+        last->size = new_size - last->address;
+        hole_index_update( last );
+    }
+    else
+    {
+        // The whole hole was released
+        before_last->next = NULL;
+        if( previous_node == last ) previous_node = before_last;
+        hole_index_remove( last );
+        node_free( last );
+    }
+
+    memory_arena_size = new_size;
+    arena_committed = new_size;
+
+    stats.trimmed_bytes = stats.trimmed_bytes + released;
+
+    return released;
+}
+
+
+/**
+ * @brief Release the free tail of the arena back to the OS
+ *
+ * When the arena ends with a hole, the pages of that hole past the 
+ * first keep_bytes are decommitted and memory_arena_size shrinks to 
+ * match. Cached quick-fit blocks are coalesced first so they do not pin 
+ * the tail. The arena grows back into the released range on demand.
+ * Only arenas backed by a reserve (see mavalloc_set_reserve) can be 
+ * trimmed, and RING arenas are never trimmed.
+ *
+ * \param keep_bytes The number of free bytes to keep committed at the end of the arena
+ * \return The number of bytes released
+ **/
+size_t mavalloc_trim( size_t keep_bytes )
+{
+    ARENA_LOCK( );
+    size_t result = trim_unlocked( keep_bytes );
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+
+/**
+ * @brief mavalloc_size() without taking the arena lock
+ **/
+int size_unlocked( )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return 0;
+
+    // The BITMAP algorithm reports its runs of units instead of nodes
+    if( heap_algo == BITMAP ) return bitmap_walk( 0 );
+
+    // The RING algorithm reports the blocks still in the buffer
+    if( heap_algo == RING ) return ring_walk( 0 );
+
+    int number_of_nodes = 0;
+
+    struct Node * runner = head_pointer;
+
+    while( runner->next != NULL )
+    {
+        number_of_nodes++;
+        runner = runner->next;
+    }
+
+    return number_of_nodes;
+}
+
+
+/*
+ * \brief Allocator size
+ *
+ * Return the number of nodes in the allocators linked list 
+ *
+ * \return The size of the allocator linked list 
+ */
+int mavalloc_size( )
+{
+    ARENA_LOCK( );
+    int result = size_unlocked( );
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+
+
+/**
+ * @brief mavalloc_print() without taking the arena lock
+ **/
+void print_unlocked( )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL ) return;
+
+    // The BITMAP algorithm prints its runs of units instead of nodes
+    if( heap_algo == BITMAP )
+    {
+        bitmap_walk( 1 );
+        return;
+    }
+
+    // The RING algorithm prints the blocks still in the buffer
+    if( heap_algo == RING )
+    {
+        ring_walk( 1 );
+        return;
+    }
+
+    int number_of_nodes = 0;
+
+    struct Node * runner = head_pointer;
 
     while( runner->next != NULL )
     {
-        if( runner->next->type == HOLE && runner->next->size >= size && runner->next->size < min )
+        number_of_nodes++;
+
+        printf(" %d) type = %d, address = %ld, size = %ld \n", number_of_nodes, runner->next->type, runner->next->address, runner->next->size);
+
+        runner = runner->next;
+    }
+
+    return;
+}
+
+
+/*
+ * \brief Print linked list
+ *
+ * Print node data for each node in the linked list
+ *
+ * \return None
+ */
+void mavalloc_print( )
+{
+    ARENA_LOCK( );
+    print_unlocked( );
+    ARENA_UNLOCK( );
+}
+
+
+// Bookkeeping of a child arena, kept at the start of its block in the parent
+struct mavalloc_arena
+{
+    struct mavalloc_arena * parent;
+    enum ARENA_ALGORITHM algorithm;
+
+    // The memory handed out and its size
+    unsigned char * base;
+    size_t size;
+
+    // Bytes in use from the start of base
+    size_t top;
+
+    // ARENA_STACK: offset of the header of the top block
+    size_t last;
+};
+
+// Child arena blocks and headers are kept 8 byte aligned
+#define ARENA_ROUND( s ) ( ( ( s ) + 7 ) & ~( size_t ) 7 )
+
+// ARENA_STACK header: the offset of the header of the block below, with 
+// the low bit set once the block is freed
+#define ARENA_HEADER sizeof( size_t )
+#define ARENA_FREED 1
+
+/**
+ * @brief Create a child arena inside a block of a parent arena
+ *
+ * The child arena takes one block of size bytes, plus room for its own 
+ * bookkeeping, from the parent and hands out memory from it with its own 
+ * algorithm. ARENA_BUMP only moves a pointer forward and gives memory 
+ * back with mavalloc_arena_reset or mavalloc_arena_destroy. ARENA_STACK 
+ * also frees blocks in last in, first out order. The whole child goes 
+ * back to the parent in one free when it is destroyed. A parent of NULL 
+ * takes the block from the main arena with mavalloc_alloc. Child 
+ * arenas can be nested.
+ *
+ * \param parent The arena to take the block from, or NULL for the main arena
+ * \param size The number of bytes the child arena can hand out
+ * \param algorithm ARENA_BUMP or ARENA_STACK
+ * \return The child arena. NULL if the parent has no room
+ **/
+struct mavalloc_arena * mavalloc_arena_create_from( struct mavalloc_arena * parent, size_t size, enum ARENA_ALGORITHM algorithm )
+{
+    if( algorithm != ARENA_BUMP && algorithm != ARENA_STACK ) return NULL;
+
+    size_t meta = ARENA_ROUND( sizeof( struct mavalloc_arena ) );
+    size_t total = meta + ARENA_ROUND( size );
+
+    // The size overflowed
+    if( total < size ) return NULL;
+
+    struct mavalloc_arena * arena;
+
+    // Child arenas of the main arena start on their own cache line
+    if( parent == NULL ) arena = mavalloc_alloc_hint( total, MAVALLOC_HINT_CACHE_ALIGN );
+    else arena = mavalloc_arena_alloc( parent, total );
+
+    if( arena == NULL ) return NULL;
+
+    arena->parent = parent;
+    arena->algorithm = algorithm;
+    arena->base = ( unsigned char * ) arena + meta;
+    arena->size = total - meta;
+    arena->top = 0;
+    arena->last = 0;
+
+    return arena;
+}
+
+
+/**
+ * @brief Allocate memory from a child arena
+ *
+ * Blocks are 8 byte aligned. ARENA_STACK blocks also carry an 8 byte 
+ * header.
+ *
+ * \param arena The child arena
+ * \param size The number of bytes to allocate
+ * \return A pointer to the memory or NULL if the child arena is full
+ **/
+void * mavalloc_arena_alloc( struct mavalloc_arena * arena, size_t size )
+{
+    return mavalloc_arena_alloc_aligned( arena, size, 8 );
+}
+
+
+/**
+ * @brief Allocate memory on an alignment boundary from a child arena
+ *
+ * The bytes skipped to reach the boundary are given back with the 
+ * block that follows them, when it is freed or the arena is reset.
+ *
+ * \param arena The child arena
+ * \param size The number of bytes to allocate
+ * \param alignment The alignment, a power of two
+ * \return A pointer to the memory or NULL if the child arena is full
+ **/
+void * mavalloc_arena_alloc_aligned( struct mavalloc_arena * arena, size_t size, size_t alignment )
+{
+    if( arena == NULL || alignment == 0 || ( alignment & ( alignment - 1 ) ) ) return NULL;
+
+    // Blocks are always 8 byte aligned
+    if( alignment < 8 ) alignment = 8;
+
+    size_t header = ( arena->algorithm == ARENA_STACK ) ? ARENA_HEADER : 0;
+    size_t total = ARENA_ROUND( size + header );
+
+    // Skip ahead to the first offset that puts the block on the boundary
+    uintptr_t start = ( uintptr_t ) ( arena->base + arena->top + header );
+    size_t pad = ( alignment - ( start & ( alignment - 1 ) ) ) & ( alignment - 1 );
+
+    // The size overflowed or the arena is full
+    if( total < size || pad > arena->size - arena->top || total > arena->size - arena->top - pad ) return NULL;
+
+    size_t offset = arena->top + pad;
+
+    // Blocks are popped back to their header, so the skipped bytes of a 
+    // stack become a freed block of their own that is popped with it
+    if( arena->algorithm == ARENA_STACK && pad > 0 )
+    {
+        *( size_t * ) ( arena->base + arena->top ) = arena->last | ARENA_FREED;
+        arena->last = arena->top;
+    }
+
+    if( arena->algorithm == ARENA_STACK )
+    {
+        // Link the block to the one below it
+        *( size_t * ) ( arena->base + offset ) = arena->last;
+        arena->last = offset;
+    }
+
+    arena->top = offset + total;
+
+    return arena->base + offset + header;
+}
+
+
+/**
+ * @brief Pops the top block of an ARENA_STACK child arena
+ *
+ * \param arena The child arena
+ * \return None
+ **/
+void child_arena_pop( struct mavalloc_arena * arena )
+{
+    arena->top = arena->last;
+
+    // The bottom block links to itself at offset 0
+    arena->last = *( size_t * ) ( arena->base + arena->last ) & ~( size_t ) ARENA_FREED;
+}
+
+
+/**
+ * @brief Free memory of a child arena
+ *
+ * ARENA_STACK releases the block and any freed blocks below it once it 
+ * is the top of the stack. ARENA_BUMP ignores single frees.
+ *
+ * \param arena The child arena
+ * \param ptr The block to free
+ * \return None
+ **/
+void mavalloc_arena_free( struct mavalloc_arena * arena, void * ptr )
+{
+    if( arena == NULL || arena->algorithm != ARENA_STACK ) return;
+
+    unsigned char * block = ptr;
+
+    // Only blocks in use can be freed
+    if( block < arena->base + ARENA_HEADER || block >= arena->base + arena->top ) return;
+
+    size_t * header = ( size_t * ) ( block - ARENA_HEADER );
+
+    *header = *header | ARENA_FREED;
+
+    // Pop the top block and any freed blocks under it
+    while( arena->top > 0 && ( *( size_t * ) ( arena->base + arena->last ) & ARENA_FREED ) )
+    {
+        child_arena_pop( arena );
+    }
+}
+
+
+/**
+ * @brief Remember how much of a child arena is in use
+ *
+ * \param arena The child arena
+ * \return A mark to pass to mavalloc_arena_reset
+ **/
+size_t mavalloc_arena_mark( struct mavalloc_arena * arena )
+{
+    if( arena == NULL ) return 0;
+
+    return arena->top;
+}
+
+
+/**
+ * @brief Free everything allocated from a child arena since a mark
+ *
+ * \param arena The child arena
+ * \param mark A mark from mavalloc_arena_mark, or 0 to empty the arena
+ * \return None
+ **/
+void mavalloc_arena_reset( struct mavalloc_arena * arena, size_t mark )
+{
+    if( arena == NULL || mark > arena->top ) return;
+
+    if( arena->algorithm == ARENA_STACK )
+    {
+        // Marks fall on block boundaries, so popping lands on the mark
+        while( arena->top > mark ) child_arena_pop( arena );
+    }
+
+    arena->top = mark;
+}
+
+
+/**
+ * @brief Give a child arena back to its parent
+ *
+ * \param arena The child arena
+ * \return None
+ **/
+void mavalloc_arena_destroy( struct mavalloc_arena * arena )
+{
+    if( arena == NULL ) return;
+
+    if( arena->parent == NULL ) mavalloc_free( arena );
+    else mavalloc_arena_free( arena->parent, arena );
+}
+
+
+/**
+ * @brief Claim a reader slot for epoch based reclamation
+ *
+ * \return The reader slot. -1 if all MAVALLOC_EPOCH_READERS slots are taken
+ **/
+int mavalloc_epoch_register( )
+{
+    int i;
+
+    for( i = 0; i < MAVALLOC_EPOCH_READERS; i++ )
+    {
+        int expected = 0;
+
+        if( __atomic_compare_exchange_n( &epoch_slots[ i ].used, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) )
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Release a reader slot
+ *
+ * \param reader The reader slot
+ * \return None
+ **/
+void mavalloc_epoch_unregister( int reader )
+{
+    if( reader < 0 || reader >= MAVALLOC_EPOCH_READERS ) return;
+
+    __atomic_store_n( &epoch_slots[ reader ].epoch, 0, __ATOMIC_RELEASE );
+    __atomic_store_n( &epoch_slots[ reader ].used, 0, __ATOMIC_RELEASE );
+}
+
+
+/**
+ * @brief Enter a read side critical section
+ *
+ * Announces the current epoch. Blocks retired after this call are not 
+ * reused until the reader exits, so the reader may keep following 
+ * pointers it loads. The call is one atomic load and store and may be 
+ * made from any thread without a lock.
+ *
+ * \param reader The reader slot
+ * \return None
+ **/
+void mavalloc_epoch_enter( int reader )
+{
+    if( reader < 0 || reader >= MAVALLOC_EPOCH_READERS ) return;
+
+    // The store must be visible before the reader loads any pointer
+    __atomic_store_n( &epoch_slots[ reader ].epoch, __atomic_load_n( &epoch_global, __ATOMIC_ACQUIRE ), __ATOMIC_SEQ_CST );
+}
+
+
+/**
+ * @brief Leave a read side critical section
+ *
+ * \param reader The reader slot
+ * \return None
+ **/
+void mavalloc_epoch_exit( int reader )
+{
+    if( reader < 0 || reader >= MAVALLOC_EPOCH_READERS ) return;
+
+    __atomic_store_n( &epoch_slots[ reader ].epoch, 0, __ATOMIC_RELEASE );
+}
+
+
+/**
+ * @brief Frees one block of an address ordered batch
+ *
+ * \param runner The node the search starts at, moved up to the block
+ * \param ptr The block
+ * \return 1 if an arena block became a hole that still has to be merged
+ **/
+int free_sorted_block( struct Node ** runner, void * ptr )
+{
+    // Blocks outside the arena may be direct mappings
+    if( ptr < memory_arena || ptr >= memory_arena + memory_arena_size )
+    {
+        free_direct( ptr );
+        return 0;
+    }
+
+    size_t address = ( unsigned char * ) ptr - ( unsigned char * ) memory_arena;
+
+    // The list and the blocks are both in address order
+    while( *runner != NULL && ( *runner )->address < address ) *runner = ( *runner )->next;
+
+    if( *runner == NULL || ( *runner )->address != address || ( *runner )->type != PROCESS ) return 0;
+
+    ( *runner )->type = HOLE;
+    ( *runner )->purged = 0;
+    used_bytes = used_bytes - ( *runner )->size;
+
+    return 1;
+}
+
+
+/**
+ * @brief Merges the holes left by a batch of frees
+ *
+ * \return None
+ **/
+void free_batch_merge( )
+{
+    if( quick_cached > 0 ) quickfit_flush( );
+    else coalesce_all( );
+}
+
+
+/**
+ * @brief mavalloc_free_batch() without taking the arena lock
+ **/
+void free_batch_unlocked( void ** ptrs, size_t count )
+{
+    // Check if linked list exists
+    if( head_pointer == NULL || ptrs == NULL ) return;
+
+    size_t i;
+
+    if( !uses_node_list( heap_algo ) )
+    {
+        for( i = 0; i < count; i++ ) free_unlocked( ptrs[ i ] );
+        return;
+    }
+
+    qsort( ptrs, count, sizeof( void * ), compare_blocks );
+
+    struct Node * runner = head_pointer->next;
+    int freed = 0;
+
+    for( i = 0; i < count; i++ ) freed |= free_sorted_block( &runner, ptrs[ i ] );
+
+    // Merge the freed blocks with their neighbours
+    if( freed ) free_batch_merge( );
+}
+
+
+/**
+ * @brief free_batch_unlocked() for blocks linked through their first word
+ *
+ * \param list The first block of the list
+ * \return None
+ **/
+void free_list_unlocked( void * list )
+{
+    if( head_pointer == NULL ) return;
+
+    void * block;
+
+    if( !uses_node_list( heap_algo ) )
+    {
+        while( list != NULL )
         {
-            min = runner->next->size;
-            best_hole_ptr = runner;
+            block = list;
+            list = block_link( block );
+            free_unlocked( block );
+        }
+
+        return;
+    }
+
+    list = sort_blocks( list );
+
+    struct Node * runner = head_pointer->next;
+    int freed = 0;
+
+    // The link is read before the block is freed, since a direct 
+    // mapping is gone once it is freed
+    while( list != NULL )
+    {
+        block = list;
+        list = block_link( block );
+        freed |= free_sorted_block( &runner, block );
+    }
+
+    if( freed ) free_batch_merge( );
+}
+
+
+/**
+ * @brief Free a number of blocks at once
+ *
+ * With the node list algorithms the pointers are sorted and matched 
+ * against the address ordered list in one pass, and the freed blocks 
+ * are merged with their neighbours in a second pass, instead of one 
+ * search per block. The blocks skip the quick-fit lists. The other 
+ * algorithms free the blocks one by one. The order of ptrs is changed.
+ *
+ * \param ptrs The blocks to free
+ * \param count The number of blocks
+ * \return None
+ **/
+void mavalloc_free_batch( void ** ptrs, size_t count )
+{
+    ARENA_LOCK( );
+    free_batch_unlocked( ptrs, count );
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief mavalloc_epoch_reclaim() without taking the arena lock
+ **/
+size_t epoch_reclaim_unlocked( )
+{
+    size_t epoch = __atomic_load_n( &epoch_global, __ATOMIC_ACQUIRE );
+    int i;
+
+    // Every reader inside a critical section must have seen this epoch
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    for( i = 0; i < MAVALLOC_EPOCH_READERS; i++ )
+    {
+        size_t announced = __atomic_load_n( &epoch_slots[ i ].epoch, __ATOMIC_ACQUIRE );
+
+        if( announced != 0 && announced != epoch ) return 0;
+    }
+
+    epoch++;
+    __atomic_store_n( &epoch_global, epoch, __ATOMIC_RELEASE );
+
+    // Readers are now in the previous epoch or the new one, so blocks 
+    // retired two epochs ago can not be reached any more
+    void * list = retire_lists[ ( epoch + 1 ) % 3 ];
+    retire_lists[ ( epoch + 1 ) % 3 ] = NULL;
+
+    size_t count = 0;
+    void * block;
+
+    for( block = list; block != NULL; block = block_link( block ) ) count++;
+
+    if( count == 0 ) return 0;
+
+    retire_pending = retire_pending - count;
+    stats.reclaimed_blocks = stats.reclaimed_blocks + count;
+
+    // The blocks are freed straight from the list, so reclaiming needs 
+    // no memory of its own
+    free_list_unlocked( list );
+
+    return count;
+}
+
+
+/**
+ * @brief Free the retired blocks that no reader can still see
+ *
+ * The epoch only moves on when every reader inside a critical section 
+ * has announced the current epoch. Blocks retired two epochs before the 
+ * new one are then sorted in place and freed in one pass, like 
+ * mavalloc_free_batch, without allocating any memory.
+ *
+ * \return The number of blocks freed
+ **/
+size_t mavalloc_epoch_reclaim( )
+{
+    ARENA_LOCK( );
+    size_t result = epoch_reclaim_unlocked( );
+    ARENA_UNLOCK( );
+
+    return result;
+}
+
+
+/**
+ * @brief mavalloc_retire() without taking the arena lock
+ **/
+void retire_unlocked( void * ptr )
+{
+    if( ptr == NULL || head_pointer == NULL ) return;
+
+    size_t epoch = __atomic_load_n( &epoch_global, __ATOMIC_ACQUIRE );
+
+    block_set_link( ptr, retire_lists[ epoch % 3 ] );
+    retire_lists[ epoch % 3 ] = ptr;
+    retire_pending++;
+
+    if( retire_pending >= EPOCH_BATCH ) epoch_reclaim_unlocked( );
+}
+
+
+/**
+ * @brief Free a block once no reader can still be using it
+ *
+ * The block is queued on the list of the current epoch, linked through 
+ * its own first word, so it must be at least sizeof( void * ) bytes and 
+ * queuing needs no memory of its own. When enough blocks are waiting 
+ * the epoch is advanced and the blocks that are safe are freed in one 
+ * batch. Retire is called by the writer, like mavalloc_free.
+ *
+ * \param ptr The block to retire
+ * \return None
+ **/
+void mavalloc_retire( void * ptr )
+{
+    ARENA_LOCK( );
+    retire_unlocked( ptr );
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief Sets up the recursive arena lock
+ *
+ * \return None
+ **/
+void arena_mutex_init( )
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init( &attr );
+    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &arena_mutex, &attr );
+    pthread_mutexattr_destroy( &attr );
+}
+
+
+/**
+ * @brief Serialize the allocator between threads
+ *
+ * When enabled, allocating, freeing, trimming, transactions, retiring 
+ * and the statistics take one recursive arena lock, so several threads 
+ * and the maintenance thread can share the arena. Configuration 
+ * functions are not locked and should be called before the arena is 
+ * shared. Epoch reader calls and child arenas never take the lock. 
+ * The lock does not make transactions per thread, see 
+ * mavalloc_txn_begin. 
+ * Enable or disable it while no other thread is using the allocator.
+ *
+ * \param enabled 1 to take the lock, 0 for single threaded use
+ * \return None
+ **/
+void mavalloc_set_thread_safe( int enabled )
+{
+    pthread_once( &arena_mutex_once, arena_mutex_init );
+
+    thread_safe = enabled;
+}
+
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds
+ *
+ * \return The current time
+ **/
+uint64_t maintenance_clock( )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+
+/**
+ * @brief Gives the whole pages inside large holes back to the OS
+ *
+ * \param budget The most bytes to purge
+ * \return None
+ **/
+void maintenance_purge( size_t budget )
+{
+    if( head_pointer == NULL || !uses_node_list( heap_algo ) ) return;
+
+    uintptr_t page = ( uintptr_t ) sysconf( _SC_PAGESIZE );
+    struct Node * runner = head_pointer->next;
+
+    while( runner != NULL && budget > 0 )
+    {
+        if( runner->type == HOLE && !runner->purged )
+        {
+            uintptr_t start = ( uintptr_t ) memory_arena + runner->address;
+            uintptr_t end = start + runner->size;
+
+            // Only whole pages can be released
+            start = ( start + page - 1 ) & ~( page - 1 );
+            end = end & ~( page - 1 );
+
+            if( end > start && end - start >= MAINTENANCE_PURGE_PAGES * page && end - start <= budget )
+            {
+                if( madvise( ( void * ) start, end - start, MADV_DONTNEED ) == 0 )
+                {
+                    runner->purged = 1;
+                    budget = budget - ( end - start );
+                    stats.purged_bytes = stats.purged_bytes + ( end - start );
+                }
+            }
+        }
+
+        runner = runner->next;
+    }
+}
+
+
+/**
+ * @brief Runs one maintenance pass
+ *
+ * \return None
+ **/
+void maintenance_pass( )
+{
+    uint64_t start = maintenance_clock( );
+
+    // Deferred coalescing of cached blocks nobody has asked for
+    ARENA_LOCK( );
+
+    if( quick_cached > 0 && quick_pops == 0 )
+    {
+        quickfit_flush( );
+        stats.maintenance_flushes++;
+    }
+
+    quick_pops = 0;
+
+    ARENA_UNLOCK( );
+
+    // Give back a free tail that no allocation has reached into for a 
+    // few passes. The last growth step stays committed, so the next 
+    // burst of allocations does not pay for growing the arena again
+    ARENA_LOCK( );
+
+    if( head_pointer != NULL && arena_reserved > 0 )
+    {
+        size_t tail = arena_tail_start( );
+
+        if( tail == maintenance_tail )
+        {
+            maintenance_tail_passes++;
+        }
+        else
+        {
+            maintenance_tail = tail;
+            maintenance_tail_passes = 0;
+        }
+
+        if( maintenance_tail_passes >= MAINTENANCE_TRIM_PASSES )
+        {
+            trim_unlocked( arena_grow_step > 0 ? arena_grow_step : memory_arena_size / 8 );
+        }
+    }
+
+    ARENA_UNLOCK( );
+
+    // Give the pages inside large holes back
+    ARENA_LOCK( );
+    maintenance_purge( maintenance_budget );
+    ARENA_UNLOCK( );
+
+    ARENA_LOCK( );
+    stats.maintenance_passes++;
+    stats.maintenance_ns = stats.maintenance_ns + ( maintenance_clock( ) - start );
+    ARENA_UNLOCK( );
+}
+
+
+/**
+ * @brief Adds milliseconds to a CLOCK_REALTIME deadline
+ *
+ * \param deadline The deadline to move
+ * \param ms The milliseconds to add
+ * \return None
+ **/
+void maintenance_deadline( struct timespec * deadline, unsigned int ms )
+{
+    clock_gettime( CLOCK_REALTIME, deadline );
+
+    deadline->tv_sec = deadline->tv_sec + ms / 1000;
+    deadline->tv_nsec = deadline->tv_nsec + ( long ) ( ms % 1000 ) * 1000000L;
+
+    if( deadline->tv_nsec >= 1000000000L )
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec = deadline->tv_nsec - 1000000000L;
+    }
+}
+
+
+/**
+ * @brief Body of the maintenance thread
+ *
+ * \param arg Unused
+ * \return NULL
+ **/
+void * maintenance_main( void * arg )
+{
+    struct timespec deadline;
+
+    ( void ) arg;
+
+    pthread_mutex_lock( &maintenance_mutex );
+
+    while( !maintenance_stopping )
+    {
+        // Sleep for the interval or until enough frees wake the thread
+        maintenance_deadline( &deadline, maintenance_interval_ms );
+
+        while( !maintenance_stopping && !maintenance_wake )
+        {
+            if( pthread_cond_timedwait( &maintenance_cond, &maintenance_mutex, &deadline ) == ETIMEDOUT ) break;
+        }
+
+        // Rate limit early wake ups
+        if( maintenance_wake && !maintenance_stopping )
+        {
+            maintenance_deadline( &deadline, MAINTENANCE_MIN_GAP_MS );
+
+            while( !maintenance_stopping )
+            {
+                if( pthread_cond_timedwait( &maintenance_cond, &maintenance_mutex, &deadline ) == ETIMEDOUT ) break;
+            }
         }
 
-        runner = runner->next;
-    }
+        maintenance_wake = 0;
+
+        if( maintenance_stopping ) break;
+
+        pthread_mutex_unlock( &maintenance_mutex );
+        maintenance_pass( );
+        pthread_mutex_lock( &maintenance_mutex );
+    }
+
+    pthread_mutex_unlock( &maintenance_mutex );
+
+    return NULL;
+}
+
+
+/**
+ * @brief Start the background maintenance thread
+ *
+ * The thread wakes every interval_ms milliseconds, or earlier after a 
+ * burst of frees, and tidies the arena so the calling threads do not 
+ * have to:
+ *
+ * - quick-fit blocks that no allocation used since the last pass are 
+ *   coalesced (deferred coalescing)
+ * - the free tail of a reserved arena is trimmed (see mavalloc_trim) 
+ *   once it stayed idle for a few passes, keeping the last growth step 
+ *   committed
+ * - the whole pages inside large holes of the node list algorithms are 
+ *   given back to the OS with madvise, up to purge_budget bytes a pass
+ *
+ * Live blocks are never moved, since the arena hands out raw pointers. 
+ * Each step takes the arena lock on its own so callers wait at most for 
+ * one step. Starting the thread enables thread safety. Time spent and 
+ * work done are reported in the statistics.
+ *
+ * \param interval_ms The time between passes in milliseconds
+ * \param purge_budget The most bytes of holes purged by one pass
+ * \return 0 on success. -1 if the thread is running or could not start
+ **/
+int mavalloc_maintenance_start( unsigned int interval_ms, size_t purge_budget )
+{
+    if( __atomic_load_n( &maintenance_running, __ATOMIC_ACQUIRE ) || head_pointer == NULL ) return -1;
+
+    mavalloc_set_thread_safe( 1 );
+
+    maintenance_interval_ms = interval_ms;
+    maintenance_budget = purge_budget;
+    maintenance_stopping = 0;
+    maintenance_wake = 0;
+    maintenance_frees = 0;
+    maintenance_tail = ( size_t ) -1;
+    maintenance_tail_passes = 0;
+
+    if( pthread_create( &maintenance_thread, NULL, maintenance_main, NULL ) ) return -1;
+
+    // Freeing threads read the flag under the arena lock, which this 
+    // thread does not hold, so it is published atomically
+    __atomic_store_n( &maintenance_running, 1, __ATOMIC_RELEASE );
+
+    return 0;
+}
+
+
+/**
+ * @brief Stop the background maintenance thread
+ *
+ * Waits for a running pass to finish. mavalloc_destroy also stops it.
+ *
+ * \return None
+ **/
+void mavalloc_maintenance_stop( )
+{
+    if( !__atomic_load_n( &maintenance_running, __ATOMIC_ACQUIRE ) ) return;
+
+    pthread_mutex_lock( &maintenance_mutex );
+    maintenance_stopping = 1;
+    pthread_cond_signal( &maintenance_cond );
+    pthread_mutex_unlock( &maintenance_mutex );
+
+    pthread_join( maintenance_thread, NULL );
+
+    __atomic_store_n( &maintenance_running, 0, __ATOMIC_RELEASE );
+}
 
-    // best_hole_ptr now points to the hole that will be used to allocate memory in the memory arena
-    return allocate_node( best_hole_ptr, size );
+
+// Bookkeeping of an I/O buffer pool. The buffers are one page aligned 
+// block of the arena
+struct mavalloc_io_pool
+{
+    unsigned char * base;
+    size_t buffer_size;
+    int count;
+
+    // Indices of the free buffers, used as a stack
+    int * free_list;
+    int free_count;
+
+    // Serializes the free list and the ring
+    pthread_mutex_t mutex;
+
+    // Ring shared with the kernel. -1 when reads and writes fall back to 
+    // pread and pwrite
+    int ring_fd;
+
+    // Mappings of the submission and completion rings and the entries
+    void * sq_map;
+    size_t sq_map_size;
+    void * cq_map;
+    size_t cq_map_size;
+    void * sqes;
+    size_t sqes_size;
+
+    // Fields of the rings inside the mappings
+    unsigned int * sq_head;
+    unsigned int * sq_tail;
+    unsigned int * sq_mask;
+    unsigned int * sq_array;
+    unsigned int * cq_head;
+    unsigned int * cq_tail;
+    unsigned int * cq_mask;
+    void * cqes;
+};
+
+// Entries of the ring of a pool. Reads and writes wait for their 
+// completion, so the ring never holds more than one
+#define IO_RING_ENTRIES 4
+
+
+/**
+ * @brief Unmaps the ring of a pool and closes it
+ *
+ * \param pool The pool
+ * \return None
+ **/
+void io_ring_close( struct mavalloc_io_pool * pool )
+{
+    if( pool->sqes != NULL ) munmap( pool->sqes, pool->sqes_size );
+    if( pool->cq_map != NULL && pool->cq_map != pool->sq_map ) munmap( pool->cq_map, pool->cq_map_size );
+    if( pool->sq_map != NULL ) munmap( pool->sq_map, pool->sq_map_size );
+    if( pool->ring_fd >= 0 ) close( pool->ring_fd );
+
+    pool->sqes = NULL;
+    pool->cq_map = NULL;
+    pool->sq_map = NULL;
+    pool->ring_fd = -1;
 }
 
+
 /**
- * @brief Worst fit heap allocation algorithm
+ * @brief Sets up an io_uring and registers the buffers of a pool with it
  *
- * \param size The size of space being requested to be allocated
- * \return void * of address of the allocated space in memory arena on success. NULL on failure.
+ * Registering pins the pages of the buffers once, so reads and writes 
+ * with IORING_OP_READ_FIXED and IORING_OP_WRITE_FIXED do not pin and 
+ * unpin them on every call. Any failure, such as a kernel without 
+ * io_uring, a seccomp filter or the locked memory limit, leaves the 
+ * pool on the pread and pwrite fallback.
+ *
+ * \param pool The pool
+ * \return 0 on success. -1 if the pool has to fall back
  **/
-void * alloc_worst_fit( size_t size )
+int io_ring_open( struct mavalloc_io_pool * pool )
 {
-    // Check if the linked list exists
-    if( head_pointer == NULL ) return NULL;
+#ifdef IO_HAVE_URING
+    struct io_uring_params params;
+    int i;
 
-    struct Node * worst_hole_ptr = NULL;
-    size_t max = 0;
+    memset( &params, 0, sizeof( params ) );
 
-    // Iterate through the linked list
-    // Store the largest eligible hole into worst_hole_ptr
-    struct Node * runner = head_pointer;
+    pool->ring_fd = syscall( __NR_io_uring_setup, IO_RING_ENTRIES, &params );
 
-    while( runner->next != NULL )
+    if( pool->ring_fd < 0 )
     {
-        if( runner->next->type == HOLE && runner->next->size >= size && runner->next->size > max )
+        pool->ring_fd = -1;
+        return -1;
+    }
+
+    pool->sq_map_size = params.sq_off.array + params.sq_entries * sizeof( unsigned int );
+    pool->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+
+    // Newer kernels map both rings with one call
+    if( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if( pool->cq_map_size > pool->sq_map_size ) pool->sq_map_size = pool->cq_map_size;
+        pool->cq_map_size = pool->sq_map_size;
+    }
+
+    pool->sq_map = mmap( NULL, pool->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pool->ring_fd, IORING_OFF_SQ_RING );
+
+    if( pool->sq_map == MAP_FAILED )
+    {
+        pool->sq_map = NULL;
+        io_ring_close( pool );
+        return -1;
+    }
+
+    if( params.features & IORING_FEAT_SINGLE_MMAP ) pool->cq_map = pool->sq_map;
+    else
+    {
+        pool->cq_map = mmap( NULL, pool->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pool->ring_fd, IORING_OFF_CQ_RING );
+
+        if( pool->cq_map == MAP_FAILED )
         {
-            max = runner->next->size;
-            worst_hole_ptr = runner;
+            pool->cq_map = NULL;
+            io_ring_close( pool );
+            return -1;
         }
+    }
 
-        runner = runner->next;
+    pool->sqes_size = params.sq_entries * sizeof( struct io_uring_sqe );
+    pool->sqes = mmap( NULL, pool->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pool->ring_fd, IORING_OFF_SQES );
+
+    if( pool->sqes == MAP_FAILED )
+    {
+        pool->sqes = NULL;
+        io_ring_close( pool );
+        return -1;
     }
 
-    // worst_hole_ptr now points to the hole that will be used to allocate memory in the memory arena
-    return allocate_node( worst_hole_ptr, size );
-} 
+    unsigned char * sq = pool->sq_map;
+    unsigned char * cq = pool->cq_map;
 
+    pool->sq_head = ( unsigned int * ) ( sq + params.sq_off.head );
+    pool->sq_tail = ( unsigned int * ) ( sq + params.sq_off.tail );
+    pool->sq_mask = ( unsigned int * ) ( sq + params.sq_off.ring_mask );
+    pool->sq_array = ( unsigned int * ) ( sq + params.sq_off.array );
+    pool->cq_head = ( unsigned int * ) ( cq + params.cq_off.head );
+    pool->cq_tail = ( unsigned int * ) ( cq + params.cq_off.tail );
+    pool->cq_mask = ( unsigned int * ) ( cq + params.cq_off.ring_mask );
+    pool->cqes = cq + params.cq_off.cqes;
 
-/**
- * @brief Allocate memory from the arena 
- *
- * This function allocated memory from the arena.  The parameter size 
- * specifies the number of bytes to allocates.  This _must_ be 4 byte aligned using the 
- * ALIGN4 macro. 
- * 
- * The function searches the arena for a free block using the heap allocation algorithm 
- * specified when the arena was allocated.
- *
- * If there is no available block of memory the function returns NULL
- *
- * \return A pointer to the available memory or NULL if no free block is found 
- **/
-void * mavalloc_alloc( size_t size )
-{
-    // 4 byte word align size
-    size_t requested_size = ALIGN4( size );
+    // Register every buffer on its own, so the index of a buffer is its 
+    // fixed buffer index
+    struct iovec * iovecs = malloc( pool->count * sizeof( struct iovec ) );
 
-    // Use heap algorithm specified at initialization
-    switch( heap_algo ) 
+    if( iovecs == NULL )
     {
-        case FIRST_FIT:
-            return alloc_first_fit( requested_size );
-            break; 
-        case NEXT_FIT:
-            return alloc_next_fit( requested_size );
-            break;
-        case BEST_FIT:
-            return alloc_best_fit( requested_size );
-            break;
-        case WORST_FIT:
-            return alloc_worst_fit( requested_size );
-            break;
-        default:
-            break;
+        io_ring_close( pool );
+        return -1;
     }
 
-    // only return NULL on failure
-    return NULL;
+    for( i = 0; i < pool->count; i++ )
+    {
+        iovecs[ i ].iov_base = pool->base + ( size_t ) i * pool->buffer_size;
+        iovecs[ i ].iov_len = pool->buffer_size;
+    }
+
+    int registered = syscall( __NR_io_uring_register, pool->ring_fd, IORING_REGISTER_BUFFERS, iovecs, pool->count );
+
+    free( iovecs );
+
+    if( registered < 0 )
+    {
+        io_ring_close( pool );
+        return -1;
+    }
+
+    return 0;
+#else
+    ( void ) pool;
+    return -1;
+#endif
 }
 
 
-/*
- * \brief free the pointer
- *
- * frees the memory block pointed to by pointer. if the block is adjacent
- * to another block then coalesce (combine) them
- *
- * \param ptr the heap memory to free
+/**
+ * @brief Reads or writes a registered buffer through the ring
  *
- * \return none
- */
-void mavalloc_free( void * ptr )
+ * \param pool The pool
+ * \param writing 1 for IORING_OP_WRITE_FIXED, 0 for IORING_OP_READ_FIXED
+ * \param fd The file
+ * \param buffer The buffer
+ * \param length The number of bytes
+ * \param offset The offset in the file
+ * \return The result of the operation, a negative errno on failure
+ **/
+long io_ring_transfer( struct mavalloc_io_pool * pool, int writing, int fd, const struct mavalloc_io_buffer * buffer, size_t length, off_t offset )
 {
-    // Check if linked list exists
-    if( head_pointer == NULL ) return;
+#ifdef IO_HAVE_URING
+    // Completions left behind by a wait that failed belong to earlier 
+    // calls, so they are dropped
+    __atomic_store_n( pool->cq_head, __atomic_load_n( pool->cq_tail, __ATOMIC_ACQUIRE ), __ATOMIC_RELEASE );
 
-    struct Node * runner = head_pointer;
-    struct Node * node;
+    unsigned int tail = *pool->sq_tail;
+    unsigned int index = tail & *pool->sq_mask;
+    struct io_uring_sqe * sqe = ( struct io_uring_sqe * ) pool->sqes + index;
 
-    // Iterate through the linked list until the address is found
-    while( runner->next->address != ptr - memory_arena )
-    {
-        runner = runner->next;
+    memset( sqe, 0, sizeof( *sqe ) );
+    sqe->opcode = writing ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = ( uintptr_t ) buffer->data;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->buf_index = buffer->index;
 
-        // The end of the linked list has been reached
-        if( runner->next == NULL ) return;
-    }
+    pool->sq_array[ index ] = index;
 
-    // runner->next is the node to be freed (x)
-    if( runner->type == HOLE && runner != head_pointer ) // Situation c)
+    // The kernel must see the entry before the new tail
+    __atomic_store_n( pool->sq_tail, tail + 1, __ATOMIC_RELEASE );
+
+    long result;
+
+    do
     {
-        node = runner->next;
-        runner->size = runner->size + node->size;
-        runner->next = node->next;
-        node_free( node );
+        result = syscall( __NR_io_uring_enter, pool->ring_fd, 1, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
     }
-    else // Situation a)
+    while( result < 0 && errno == EINTR );
+
+    if( result < 0 )
     {
-        runner = runner->next;
-        runner->type = HOLE;
-    }
+        result = -errno;
 
-    // runner is now the node that has been freed (x or x/a)
-    if( runner->next == NULL ) return; // runner is at end of linked list
+        // An entry the kernel did not take would otherwise be submitted 
+        // by the next call
+        if( __atomic_load_n( pool->sq_head, __ATOMIC_ACQUIRE ) == tail )
+        {
+            __atomic_store_n( pool->sq_tail, tail, __ATOMIC_RELEASE );
+        }
 
-    if( runner->next->type == HOLE ) // Situation b) and d)
-    {
-        node = runner->next;
-        runner->size = runner->size + node->size;
-        runner->next = node->next;
-        node_free( node );
+        return result;
     }
 
-    return;
+    unsigned int head = *pool->cq_head;
+
+    // The completion was waited for, so it is in the ring
+    if( head == __atomic_load_n( pool->cq_tail, __ATOMIC_ACQUIRE ) ) return -EIO;
+
+    struct io_uring_cqe * cqe = ( struct io_uring_cqe * ) pool->cqes + ( head & *pool->cq_mask );
+
+    result = cqe->res;
+
+    __atomic_store_n( pool->cq_head, head + 1, __ATOMIC_RELEASE );
+
+    return result;
+#else
+    ( void ) pool;
+    ( void ) writing;
+    ( void ) fd;
+    ( void ) buffer;
+    ( void ) length;
+    ( void ) offset;
+    return -ENOSYS;
+#endif
 }
 
 
-/*
- * \brief Allocator size
+/**
+ * @brief Create a pool of page aligned I/O buffers in the arena
  *
- * Return the number of nodes in the allocators linked list 
+ * The buffers are carved from one page aligned block of the arena and, 
+ * where the kernel supports it, registered with an io_uring of the pool 
+ * as fixed buffers. Reads and writes then go straight between the file 
+ * and the arena with IORING_OP_READ_FIXED and IORING_OP_WRITE_FIXED, 
+ * with no copy and no pinning of pages on every call. Without io_uring 
+ * the pool falls back to pread and pwrite on the same buffers.
  *
- * \return The size of the allocator linked list 
- */
-int mavalloc_size( )
+ * \param buffer_size The size of each buffer, rounded up to whole pages
+ * \param count The number of buffers
+ * \param flags MAVALLOC_IO_FALLBACK to never use io_uring, or 0
+ * \return The pool. NULL if the arena has no room
+ **/
+struct mavalloc_io_pool * mavalloc_io_pool_create( size_t buffer_size, int count, int flags )
 {
-    // Check if linked list exists
-    if( head_pointer == NULL ) return 0;
+    int i;
 
-    int number_of_nodes = 0;
+    if( buffer_size == 0 || count <= 0 ) return NULL;
 
-    struct Node * runner = head_pointer;
+    size_t page = sysconf( _SC_PAGESIZE );
 
-    while( runner->next != NULL )
+    buffer_size = page_round( buffer_size );
+
+    // The size overflowed
+    if( buffer_size == 0 || buffer_size > ( ( size_t ) -1 ) / count ) return NULL;
+
+    struct mavalloc_io_pool * pool = calloc( 1, sizeof( struct mavalloc_io_pool ) );
+
+    if( pool == NULL ) return NULL;
+
+    pool->free_list = malloc( count * sizeof( int ) );
+    pool->base = mavalloc_alloc_aligned( buffer_size * count, page );
+
+    if( pool->free_list == NULL || pool->base == NULL )
     {
-        number_of_nodes++;
-        runner = runner->next;
+        mavalloc_free( pool->base );
+        free( pool->free_list );
+        free( pool );
+        return NULL;
     }
 
-    return number_of_nodes;
+    pool->buffer_size = buffer_size;
+    pool->count = count;
+    pool->ring_fd = -1;
+
+    // Hand out the lowest buffers first
+    for( i = 0; i < count; i++ ) pool->free_list[ i ] = count - 1 - i;
+    pool->free_count = count;
+
+    pthread_mutex_init( &pool->mutex, NULL );
+
+    if( !( flags & MAVALLOC_IO_FALLBACK ) ) io_ring_open( pool );
+
+    return pool;
 }
 
 
+/**
+ * @brief Check whether a pool uses io_uring fixed buffers
+ *
+ * \param pool The pool
+ * \return 1 if reads and writes go through io_uring. 0 if they fall back to pread and pwrite
+ **/
+int mavalloc_io_pool_fixed( struct mavalloc_io_pool * pool )
+{
+    return pool != NULL && pool->ring_fd >= 0;
+}
+
 
-/*
- * \brief Print linked list
+/**
+ * @brief Take a buffer from a pool
  *
- * Print node data for each node in the linked list
+ * \param pool The pool
+ * \param buffer Where to store the address, size and index of the buffer
+ * \return 0 on success. -1 if every buffer is in use
+ **/
+int mavalloc_io_pool_get( struct mavalloc_io_pool * pool, struct mavalloc_io_buffer * buffer )
+{
+    if( pool == NULL || buffer == NULL ) return -1;
+
+    pthread_mutex_lock( &pool->mutex );
+
+    if( pool->free_count == 0 )
+    {
+        pthread_mutex_unlock( &pool->mutex );
+        return -1;
+    }
+
+    int index = pool->free_list[ --pool->free_count ];
+
+    pthread_mutex_unlock( &pool->mutex );
+
+    buffer->data = pool->base + ( size_t ) index * pool->buffer_size;
+    buffer->size = pool->buffer_size;
+    buffer->index = index;
+
+    return 0;
+}
+
+
+/**
+ * @brief Give a buffer back to its pool
  *
+ * \param pool The pool
+ * \param buffer The buffer
  * \return None
- */
-void mavalloc_print( )
+ **/
+void mavalloc_io_pool_put( struct mavalloc_io_pool * pool, struct mavalloc_io_buffer * buffer )
 {
-    // Check if linked list exists
-    if( head_pointer == NULL ) return;
+    if( pool == NULL || buffer == NULL || buffer->index < 0 || buffer->index >= pool->count ) return;
 
-    int number_of_nodes = 0;
+    pthread_mutex_lock( &pool->mutex );
 
-    struct Node * runner = head_pointer;
+    // The stack can not hold more buffers than the pool has
+    if( pool->free_count < pool->count ) pool->free_list[ pool->free_count++ ] = buffer->index;
 
-    while( runner->next != NULL )
+    pthread_mutex_unlock( &pool->mutex );
+
+    buffer->data = NULL;
+    buffer->index = -1;
+}
+
+
+/**
+ * @brief Reads or writes a buffer of a pool
+ *
+ * \param pool The pool
+ * \param writing 1 to write the buffer, 0 to read into it
+ * \param fd The file
+ * \param buffer The buffer
+ * \param length The number of bytes, at most the size of the buffer
+ * \param offset The offset in the file
+ * \return The number of bytes transferred, or -1 with errno set
+ **/
+ssize_t io_pool_transfer( struct mavalloc_io_pool * pool, int writing, int fd, const struct mavalloc_io_buffer * buffer, size_t length, off_t offset )
+{
+    if( pool == NULL || buffer == NULL || buffer->index < 0 || buffer->index >= pool->count || length > pool->buffer_size )
     {
-        number_of_nodes++;
+        errno = EINVAL;
+        return -1;
+    }
 
-        printf(" %d) type = %d, address = %ld, size = %ld \n", number_of_nodes, runner->next->type, runner->next->address, runner->next->size);
+    ssize_t result;
 
-        runner = runner->next;
+    if( pool->ring_fd >= 0 )
+    {
+        pthread_mutex_lock( &pool->mutex );
+        result = io_ring_transfer( pool, writing, fd, buffer, length, offset );
+        pthread_mutex_unlock( &pool->mutex );
+
+        if( result >= 0 )
+        {
+            ARENA_LOCK( );
+            stats.io_fixed_ops++;
+            ARENA_UNLOCK( );
+
+            return result;
+        }
+
+        // A kernel or file that refuses fixed buffer operations still 
+        // gets the transfer through pread and pwrite
+        if( result != -EINVAL && result != -EOPNOTSUPP && result != -EPERM && result != -ENOSYS )
+        {
+            errno = -result;
+            return -1;
+        }
     }
 
-    return;
+    if( writing ) result = pwrite( fd, buffer->data, length, offset );
+    else result = pread( fd, buffer->data, length, offset );
+
+    if( result >= 0 )
+    {
+        ARENA_LOCK( );
+        stats.io_fallback_ops++;
+        ARENA_UNLOCK( );
+    }
+
+    return result;
+}
+
+
+/**
+ * @brief Read from a file into a buffer of a pool
+ *
+ * Works like pread. With io_uring the read is an IORING_OP_READ_FIXED 
+ * on the registered buffer, and the call waits for it to complete. A 
+ * read the kernel refuses as a fixed operation is retried with pread.
+ *
+ * \param pool The pool
+ * \param fd The file
+ * \param buffer The buffer
+ * \param length The number of bytes, at most the size of the buffer
+ * \param offset The offset in the file
+ * \return The number of bytes read, or -1 with errno set
+ **/
+ssize_t mavalloc_io_read( struct mavalloc_io_pool * pool, int fd, const struct mavalloc_io_buffer * buffer, size_t length, off_t offset )
+{
+    return io_pool_transfer( pool, 0, fd, buffer, length, offset );
+}
+
+
+/**
+ * @brief Write a buffer of a pool to a file
+ *
+ * Works like pwrite. With io_uring the write is an 
+ * IORING_OP_WRITE_FIXED on the registered buffer, and the call waits 
+ * for it to complete. A write the kernel refuses as a fixed operation 
+ * is retried with pwrite.
+ *
+ * \param pool The pool
+ * \param fd The file
+ * \param buffer The buffer
+ * \param length The number of bytes, at most the size of the buffer
+ * \param offset The offset in the file
+ * \return The number of bytes written, or -1 with errno set
+ **/
+ssize_t mavalloc_io_write( struct mavalloc_io_pool * pool, int fd, const struct mavalloc_io_buffer * buffer, size_t length, off_t offset )
+{
+    return io_pool_transfer( pool, 1, fd, buffer, length, offset );
 }
 
 
+/**
+ * @brief Destroy a pool and give its buffers back to the arena
+ *
+ * Closing the ring unregisters the buffers. No buffer of the pool may 
+ * be in use.
+ *
+ * \param pool The pool
+ * \return None
+ **/
+void mavalloc_io_pool_destroy( struct mavalloc_io_pool * pool )
+{
+    if( pool == NULL ) return;
+
+    io_ring_close( pool );
 
+    mavalloc_free( pool->base );
+
+    pthread_mutex_destroy( &pool->mutex );
+    free( pool->free_list );
+    free( pool );
+}
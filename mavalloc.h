@@ -21,8 +21,15 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#ifndef MAVALLOC_H
+#define MAVALLOC_H
 
 #include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define ALIGN4(s)  (((((s) - 1) >> 2) << 2) + 4)
 
@@ -31,9 +38,183 @@ enum ALGORITHM
   FIRST_FIT = 0,
   NEXT_FIT,
   BEST_FIT,
-  WORST_FIT
+  WORST_FIT,
+  BITMAP,
+  RING,
+  ADAPTIVE,
+  GOOD_FIT
 }; 
 
+// Default number of bytes tracked by each bit of the BITMAP algorithm
+#define MAVALLOC_BITMAP_UNIT 16
+
+// Structures that can index the holes of the node list algorithms
+enum HOLE_INDEX
+{
+  HOLE_INDEX_LIST = 0,
+  HOLE_INDEX_CARTESIAN
+};
+
+// Size-class rounding policies applied by mavalloc_alloc before the search
+enum ROUNDING
+{
+  ROUND_ALIGN4 = 0,
+  ROUND_QUANTUM,
+  ROUND_POWER_OF_TWO,
+  ROUND_GEOMETRIC
+};
+
+// Default search bound and close fit slack of the GOOD_FIT algorithm
+#define MAVALLOC_GOOD_FIT_CANDIDATES 8
+#define MAVALLOC_GOOD_FIT_SLACK 10
+
+// Maximum number of exact sizes the quick-fit lists can cache
+#define MAVALLOC_QUICKFIT_MAX 8
+
+// Smallest block that cache coloring offsets
+#define MAVALLOC_COLOR_MIN_SIZE 4096
+
+// Algorithms of child arenas made by mavalloc_arena_create_from
+enum ARENA_ALGORITHM
+{
+  ARENA_BUMP = 0,
+  ARENA_STACK
+};
+
+// A child arena carved from a block of a parent arena
+struct mavalloc_arena;
+
+// State saved by mavalloc_txn_begin for a rollback. Only the allocator 
+// reads the fields
+struct mavalloc_txn
+{
+  size_t serial;
+  size_t ring_pushed;
+  size_t ring_tail;
+  size_t log_length;
+};
+
+// Number of reader slots for epoch based reclamation
+#define MAVALLOC_EPOCH_READERS 64
+
+// Lifetime hints for mavalloc_alloc_hint
+#define MAVALLOC_HINT_SHORT     0x1
+#define MAVALLOC_HINT_LONG      0x2
+#define MAVALLOC_HINT_PERMANENT 0x4
+
+// Start the block on its own cache line, see mavalloc_set_cache_align
+#define MAVALLOC_HINT_CACHE_ALIGN 0x8
+
+// Cache line size used by cache line alignment
+#define MAVALLOC_CACHE_LINE 64
+
+// Limits reported to the pressure callback, see mavalloc_set_limits
+enum MAVALLOC_PRESSURE
+{
+  MAVALLOC_PRESSURE_SOFT = 0,
+  MAVALLOC_PRESSURE_HARD
+};
+
+// Called with the limit that was reached, the bytes in use, the size of 
+// the request that reached it and the context given with the callback
+typedef void ( * mavalloc_pressure_callback )( enum MAVALLOC_PRESSURE level, size_t used_bytes, size_t request, void * context );
+
+// A pool of page aligned I/O buffers carved from the arena
+struct mavalloc_io_pool;
+
+// A buffer of an I/O pool. Index is the io_uring fixed buffer index
+struct mavalloc_io_buffer
+{
+  void * data;
+  size_t size;
+  int index;
+};
+
+// Make an I/O pool that always uses pread and pwrite
+#define MAVALLOC_IO_FALLBACK 0x1
+
+// Allocator statistics, reset by mavalloc_init
+struct mavalloc_stats
+{
+  // Allocations that got a whole hole because the remainder was below 
+  // the split threshold, and the extra bytes they were given
+  size_t unsplit_allocations;
+  size_t unsplit_slack_bytes;
+
+  // Bytes asked for by successful allocations, and the bytes added by 
+  // rounding them up to their size class
+  size_t requested_bytes;
+  size_t rounding_slack_bytes;
+
+  // Blocks currently served by their own mapping, and the bytes mapped
+  size_t direct_mapped_blocks;
+  size_t direct_mapped_bytes;
+
+  // Bytes given back to the OS by mavalloc_trim
+  size_t trimmed_bytes;
+
+  // Nodes visited by the fit searches, and allocations that failed
+  size_t search_steps;
+  size_t failed_allocations;
+
+  // Policy switches made by ADAPTIVE, and the fit policy that is running
+  size_t algorithm_switches;
+  enum ALGORITHM active_algorithm;
+
+  // GOOD_FIT searches cut short by the candidate bound, and searches 
+  // that stopped early on a close enough fit
+  size_t good_fit_bound_hits;
+  size_t good_fit_close_fits;
+
+  // Successful allocations made with each lifetime hint
+  size_t short_allocations;
+  size_t long_allocations;
+  size_t permanent_allocations;
+
+  // Allocations placed by mavalloc_alloc_near, and the total bytes 
+  // between each block and the hole side it was carved from
+  size_t near_allocations;
+  size_t near_distance_bytes;
+
+  // Large blocks pushed to another cache color, and the bytes skipped
+  size_t colored_allocations;
+  size_t color_offset_bytes;
+
+  // Bytes released in front of blocks to move them onto an alignment 
+  // boundary
+  size_t aligned_pad_bytes;
+
+  // Retired blocks freed by epoch based reclamation
+  size_t reclaimed_blocks;
+
+  // Maintenance thread passes, the nanoseconds they took, the quick-fit 
+  // flushes they made and the bytes of holes they gave back to the OS
+  size_t maintenance_passes;
+  size_t maintenance_ns;
+  size_t maintenance_flushes;
+  size_t purged_bytes;
+
+  // Allocations refused by the hard limit, and calls made to the 
+  // pressure callback
+  size_t limit_failures;
+  size_t pressure_callbacks;
+
+  // Bytes of the blocks in use when the statistics were copied
+  size_t used_bytes;
+
+  // Reads and writes of I/O buffer pools made through io_uring fixed 
+  // buffers, and made with pread and pwrite
+  size_t io_fixed_ops;
+  size_t io_fallback_ops;
+
+  // Snapshot of the holes of the node list algorithms when the 
+  // statistics were copied. The free bytes outside the largest hole 
+  // show how fragmented the arena is
+  size_t free_bytes;
+  size_t free_holes;
+  size_t largest_hole;
+};
+
 /**
  * @brief Initialize the allocation arena and set the algorithm type
  *
@@ -49,6 +230,86 @@ enum ALGORITHM
  **/
 int mavalloc_init( size_t size, enum ALGORITHM algorithm );
 
+/**
+ * @brief Number of arenas set up so far
+ *
+ * Every successful mavalloc_init starts a new generation. Caches that 
+ * keep freed blocks outside the allocator compare it with the 
+ * generation they were filled in, so they never hand out blocks of an 
+ * arena that was destroyed.
+ *
+ * \return The generation of the current arena
+ **/
+unsigned int mavalloc_generation( );
+
+
+/**
+ * @brief Switch the heap algorithm at runtime
+ *
+ * FIRST_FIT, NEXT_FIT, BEST_FIT, WORST_FIT, GOOD_FIT and ADAPTIVE all work on 
+ * the same address ordered list of holes, so an arena can move between 
+ * them at any time. BITMAP and RING keep their own structures and can 
+ * only be chosen by mavalloc_init.
+ *
+ * ADAPTIVE samples the search length, failure rate and fragmentation of 
+ * the fit policy it is running and moves between FIRST_FIT, NEXT_FIT 
+ * and BEST_FIT as the workload changes, with hysteresis so it does not 
+ * flip back and forth.
+ *
+ * \param algorithm The heap algorithm to use from now on
+ * \return 0 on success. -1 if the arena can not switch to the algorithm
+ **/
+int mavalloc_set_algorithm( enum ALGORITHM algorithm );
+
+
+/**
+ * @brief Configure the GOOD_FIT algorithm
+ *
+ * GOOD_FIT is best fit with a bounded search. It takes the first hole 
+ * that is at most slack_percent larger than the request, or the smallest 
+ * of the first candidates eligible holes, whichever comes first. This 
+ * caps the worst case allocation latency while keeping fragmentation 
+ * close to best fit. The statistics count how often each bound stopped 
+ * the search.
+ *
+ * \param candidates The most eligible holes to look at before taking the best one
+ * \param slack_percent How much larger than the request a hole may be and still be taken at once
+ * \return 0 on success. -1 if the values are out of range
+ **/
+int mavalloc_set_good_fit( int candidates, int slack_percent );
+
+
+/**
+ * @brief Select the structure that indexes the holes
+ *
+ * HOLE_INDEX_LIST (the default) finds holes by walking the address 
+ * ordered linked list. HOLE_INDEX_CARTESIAN also keeps the holes in a 
+ * Cartesian tree that is ordered by address and heap ordered by size, 
+ * as in Stephenson's fast fits. FIRST_FIT then finds the lowest fitting 
+ * hole, BEST_FIT a small fitting hole ("better fit") and WORST_FIT the 
+ * largest hole, each down a single path of the tree instead of a full 
+ * walk of the list. Better fit looks at one hole per level, so it may 
+ * settle for a hole slightly larger than the true best fit. The other 
+ * algorithms keep walking the list. The index can be changed at any time.
+ *
+ * \param index HOLE_INDEX_LIST or HOLE_INDEX_CARTESIAN
+ * \return 0 on success. -1 if the index is unknown
+ **/
+int mavalloc_set_hole_index( enum HOLE_INDEX index );
+
+
+/**
+ * @brief Set the allocation unit of the BITMAP algorithm
+ *
+ * The BITMAP algorithm tracks the arena with one occupancy bit per unit
+ * and hands out whole runs of units. The unit must be a power of two of
+ * at least 4 bytes and takes effect on the next call to mavalloc_init.
+ *
+ * \param unit The number of bytes covered by one bit
+ * \return 0 on success. -1 if the unit is invalid
+ **/
+int mavalloc_set_bitmap_unit( size_t unit );
+
 
 /**
  * @brief Destroy the arena 
@@ -65,7 +326,8 @@ void mavalloc_destroy( );
  *
  * This function allocated memory from the arena.  The parameter size 
  * specifies the number of bytes to allocates.  This _must_ be 4 byte aligned using the 
- * ALIGN4 macro. 
+ * ALIGN4 macro, and is then rounded up to a size class by the policy set 
+ * with mavalloc_set_rounding. 
  * 
  * The function searches the arena for a free block using the heap allocation algorithm 
  * specified when the arena was allocated.
@@ -77,6 +339,62 @@ void mavalloc_destroy( );
 void * mavalloc_alloc( size_t size );
 
 
+/**
+ * @brief Allocate memory with a lifetime hint
+ *
+ * Works like mavalloc_alloc. With the node list algorithms, blocks 
+ * hinted MAVALLOC_HINT_LONG or MAVALLOC_HINT_PERMANENT are carved from 
+ * the top of the highest fitting hole, so they collect at the high end 
+ * of the arena. Short lived and unhinted blocks are placed by the heap 
+ * algorithm and fill the arena from the low end. Churn among the short 
+ * lived blocks then leaves holes that merge with each other instead of 
+ * holes pinned between long lived blocks. BITMAP and RING ignore the hint.
+ *
+ * Hinted allocations are counted in the statistics, which also report 
+ * the free bytes, holes and largest hole, so runs with and without 
+ * hints can be compared.
+ *
+ * \param size The number of bytes to allocate
+ * \param flags One of MAVALLOC_HINT_SHORT, MAVALLOC_HINT_LONG or 
+ *              MAVALLOC_HINT_PERMANENT, or 0 for no hint, optionally 
+ *              combined with MAVALLOC_HINT_CACHE_ALIGN
+ * \return A pointer to the available memory or NULL if no free block is found 
+ **/
+void * mavalloc_alloc_hint( size_t size, int flags );
+
+
+/**
+ * @brief Allocate memory close to an existing block
+ *
+ * Works like mavalloc_alloc, but with the node list algorithms the block 
+ * goes in the fitting hole nearest by address to hint_ptr, at the end of 
+ * that hole facing hint_ptr. Related objects such as a parent and its 
+ * children then share cache lines and pages. If hint_ptr is NULL or not 
+ * in the arena, or the arena uses BITMAP or RING, the heap algorithm 
+ * places the block as usual.
+ *
+ * \param hint_ptr The block to allocate close to
+ * \param size The number of bytes to allocate
+ * \return A pointer to the available memory or NULL if no free block is found 
+ **/
+void * mavalloc_alloc_near( void * hint_ptr, size_t size );
+
+/**
+ * @brief Allocate memory on an alignment boundary
+ *
+ * Works like mavalloc_alloc, but the block starts on a multiple of 
+ * alignment. The node list algorithms carve the block out of a larger 
+ * span and give the bytes around it back as holes. BITMAP and RING can 
+ * only return blocks that happen to be aligned, and direct mappings are 
+ * page aligned. Blocks are freed with mavalloc_free.
+ *
+ * \param size The number of bytes to allocate
+ * \param alignment The alignment, a power of two
+ * \return A pointer to the available memory or NULL if no aligned block is found
+ **/
+void * mavalloc_alloc_aligned( size_t size, size_t alignment );
+
+
 /*
  * \brief free the pointer
  *
@@ -89,6 +407,198 @@ void * mavalloc_alloc( size_t size );
  */
 void mavalloc_free(void *ptr);
 
+/**
+ * @brief Enable quick-fit lists in front of the heap algorithm
+ *
+ * Freed blocks of the most frequently used exact sizes are parked on 
+ * per-size lists instead of being coalesced, and mavalloc_alloc hands 
+ * them back out before running the heap algorithm. Sizes are learned
+ * from the blocks being freed unless reserved with mavalloc_quickfit_size.
+ * Cached blocks are coalesced again when an allocation would otherwise fail.
+ *
+ * Quick-fit applies to FIRST_FIT, NEXT_FIT, BEST_FIT and WORST_FIT.
+ *
+ * \param lists The number of exact sizes to cache, up to MAVALLOC_QUICKFIT_MAX. 
+ *              0 disables quick-fit
+ * \param depth The maximum number of blocks cached for each size
+ * \return 0 on success. -1 if the values are out of range
+ **/
+int mavalloc_quickfit( int lists, int depth );
+
+/**
+ * @brief Reserve a quick-fit list for an exact size
+ *
+ * \param size The size to cache
+ * \return 0 on success. -1 if every list is already reserved
+ **/
+int mavalloc_quickfit_size( size_t size );
+
+/**
+ * @brief Set the size-class rounding policy
+ *
+ * ROUND_ALIGN4 (the default) only aligns requests to 4 bytes. 
+ * ROUND_QUANTUM rounds up to a multiple of the quantum, ROUND_POWER_OF_TWO
+ * to the next power of two, and ROUND_GEOMETRIC to one of four classes 
+ * per doubling (20, 24, 28, 32, 40, 48, ...). Coarser classes make freed 
+ * holes reusable by more requests at the cost of internal fragmentation,
+ * which is reported in the statistics.
+ *
+ * \param policy The rounding policy
+ * \param quantum The size class spacing for ROUND_QUANTUM. It must be a 
+ *                multiple of 4 and is ignored by the other policies
+ * \return 0 on success. -1 if the quantum is invalid
+ **/
+int mavalloc_set_rounding( enum ROUNDING policy, size_t quantum );
+
+/**
+ * @brief Set the direct mapping threshold
+ *
+ * Requests of at least this many bytes (after rounding) are served by 
+ * their own anonymous mapping instead of a block in the arena, so a 
+ * single huge block can not fragment the arena. mavalloc_free unmaps 
+ * them and returns the memory to the OS at once. Direct mappings are 
+ * not counted by mavalloc_size. The default of 0 disables direct mapping.
+ *
+ * \param threshold The smallest request served by its own mapping. 0 disables it
+ * \return None
+ **/
+void mavalloc_set_mmap_threshold( size_t threshold );
+
+/**
+ * @brief Set the virtual range reserved for the arena
+ *
+ * When the reserve is larger than the size given to mavalloc_init, the 
+ * arena is backed by a reserved range of address space instead of 
+ * malloc. Only the pages covering the initial size are committed, and 
+ * more pages are committed whenever an allocation does not fit, so the 
+ * arena grows in place and its holes keep coalescing across the whole 
+ * range. Growth applies to every algorithm except RING. The reserve 
+ * takes effect on the next call to mavalloc_init. The default of 0 
+ * allocates a fixed arena with malloc.
+ *
+ * \param reserve The number of bytes of address space to reserve. 0 disables it
+ * \return None
+ **/
+void mavalloc_set_reserve( size_t reserve );
+
+/**
+ * @brief Configure cache coloring of large blocks
+ *
+ * Blocks of MAVALLOC_COLOR_MIN_SIZE bytes or more that are split from 
+ * the start of a hole are pushed forward by a rotating multiple of the 
+ * stride: 0, stride, 2 * stride and so on up to colors - 1 strides. 
+ * Equally sized large blocks then start at different cache set offsets 
+ * instead of all conflicting in the same sets. The bytes skipped stay 
+ * a hole in front of the block, so they merge back when it is freed. 
+ * A hole that can not fit the offset hands out its start as usual and 
+ * keeps the color for the next block. Offsets below the split threshold 
+ * are passed over, since they would only leave sliver holes. 
+ * Coloring applies to the node list algorithms and is off by default.
+ *
+ * \param stride The color step in bytes, normally the cache line size. 0 disables coloring
+ * \param colors The number of offsets to rotate through
+ * \return 0 on success. -1 if the values are out of range
+ **/
+int mavalloc_set_coloring( size_t stride, int colors );
+
+/**
+ * @brief Get the cache color stride
+ *
+ * \return The color step in bytes. 0 when coloring is off
+ **/
+size_t mavalloc_get_color_stride( );
+
+/**
+ * @brief Keep every block on cache lines of its own
+ *
+ * When enabled, every block is rounded up to a multiple of 
+ * MAVALLOC_CACHE_LINE bytes and starts on a cache line boundary, so 
+ * objects handed to different threads never share a line and can not 
+ * false share. Single allocations can ask for the same treatment with 
+ * the MAVALLOC_HINT_CACHE_ALIGN flag of mavalloc_alloc_hint. Alignment 
+ * applies to the node list algorithms. BITMAP and RING only round the 
+ * size. The default is off.
+ *
+ * \param enabled 1 to align every block, 0 to pack blocks on 4 byte words
+ * \return None
+ **/
+void mavalloc_set_cache_align( int enabled );
+
+/**
+ * @brief Set the minimum split remainder
+ *
+ * A hole is only split when at least this many bytes would be left in 
+ * the new hole. Otherwise the whole hole is handed out and the extra 
+ * bytes are counted in the statistics. The default of 0 always splits.
+ *
+ * \param threshold The minimum number of bytes worth keeping as a hole
+ * \return None
+ **/
+void mavalloc_set_split_threshold( size_t threshold );
+
+/**
+ * @brief Set the soft and hard memory limits of the arena
+ *
+ * The allocator keeps a running count of the bytes in use, the blocks 
+ * handed out and not yet freed including their rounding, headers and 
+ * direct mappings, so both limits are checked without walking the 
+ * arena. An allocation that takes the count past the soft limit calls 
+ * the pressure callback once, so caches can evict, and the callback is 
+ * armed again when the count falls back under the limit. An allocation 
+ * that would go past the hard limit first calls the callback and then 
+ * fails if there is still no room, even when the arena has space. 
+ * Cached quick-fit blocks are not counted as in use. Child arenas count 
+ * against the arena they are carved from. The limits persist across 
+ * mavalloc_init.
+ *
+ * \param soft_limit The bytes in use that trigger the callback. 0 for none
+ * \param hard_limit The most bytes that may be in use. 0 for none
+ * \return 0 on success. -1 if the soft limit is above the hard limit
+ **/
+int mavalloc_set_limits( size_t soft_limit, size_t hard_limit );
+
+/**
+ * @brief Set the function called when a memory limit is reached
+ *
+ * The callback runs inside the allocation that reached the limit. It 
+ * may free and allocate blocks, and is not called again while it runs.
+ *
+ * \param callback The function to call, or NULL for none
+ * \param context Passed to the callback unchanged
+ * \return None
+ **/
+void mavalloc_set_pressure_callback( mavalloc_pressure_callback callback, void * context );
+
+/**
+ * @brief Bytes of the blocks in use
+ *
+ * \return The running count compared against the limits
+ **/
+size_t mavalloc_used_bytes( );
+
+/**
+ * @brief Copy the allocator statistics
+ *
+ * \param out Where to copy the statistics
+ * \return None
+ **/
+void mavalloc_get_stats( struct mavalloc_stats * out );
+
+/**
+ * @brief Release the free tail of the arena back to the OS
+ *
+ * When the arena ends with a hole, the pages of that hole past the 
+ * first keep_bytes are decommitted and memory_arena_size shrinks to 
+ * match. Cached quick-fit blocks are coalesced first so they do not pin 
+ * the tail. The arena grows back into the released range on demand.
+ * Only arenas backed by a reserve (see mavalloc_set_reserve) can be 
+ * trimmed, and RING arenas are never trimmed.
+ *
+ * \param keep_bytes The number of free bytes to keep committed at the end of the arena
+ * \return The number of bytes released
+ **/
+size_t mavalloc_trim( size_t keep_bytes );
+
 /*
  * \brief Allocator size
  *
@@ -106,3 +616,350 @@ int mavalloc_size( );
  * \return None
  */
 void mavalloc_print( );
+
+/**
+ * @brief Create a child arena inside a block of a parent arena
+ *
+ * The child arena takes one block of size bytes, plus room for its own 
+ * bookkeeping, from the parent and hands out memory from it with its own 
+ * algorithm. ARENA_BUMP only moves a pointer forward and gives memory 
+ * back with mavalloc_arena_reset or mavalloc_arena_destroy. ARENA_STACK 
+ * also frees blocks in last in, first out order. The whole child goes 
+ * back to the parent in one free when it is destroyed. A parent of NULL 
+ * takes the block from the main arena with mavalloc_alloc. Child 
+ * arenas can be nested.
+ *
+ * \param parent The arena to take the block from, or NULL for the main arena
+ * \param size The number of bytes the child arena can hand out
+ * \param algorithm ARENA_BUMP or ARENA_STACK
+ * \return The child arena. NULL if the parent has no room
+ **/
+struct mavalloc_arena * mavalloc_arena_create_from( struct mavalloc_arena * parent, size_t size, enum ARENA_ALGORITHM algorithm );
+
+/**
+ * @brief Allocate memory from a child arena
+ *
+ * Blocks are 8 byte aligned. ARENA_STACK blocks also carry an 8 byte 
+ * header.
+ *
+ * \param arena The child arena
+ * \param size The number of bytes to allocate
+ * \return A pointer to the memory or NULL if the child arena is full
+ **/
+void * mavalloc_arena_alloc( struct mavalloc_arena * arena, size_t size );
+
+/**
+ * @brief Allocate memory on an alignment boundary from a child arena
+ *
+ * The bytes skipped to reach the boundary are given back with the 
+ * block that follows them, when it is freed or the arena is reset.
+ *
+ * \param arena The child arena
+ * \param size The number of bytes to allocate
+ * \param alignment The alignment, a power of two
+ * \return A pointer to the memory or NULL if the child arena is full
+ **/
+void * mavalloc_arena_alloc_aligned( struct mavalloc_arena * arena, size_t size, size_t alignment );
+
+/**
+ * @brief Free memory of a child arena
+ *
+ * ARENA_STACK releases the block and any freed blocks below it once it 
+ * is the top of the stack. ARENA_BUMP ignores single frees.
+ *
+ * \param arena The child arena
+ * \param ptr The block to free
+ * \return None
+ **/
+void mavalloc_arena_free( struct mavalloc_arena * arena, void * ptr );
+
+/**
+ * @brief Remember how much of a child arena is in use
+ *
+ * \param arena The child arena
+ * \return A mark to pass to mavalloc_arena_reset
+ **/
+size_t mavalloc_arena_mark( struct mavalloc_arena * arena );
+
+/**
+ * @brief Free everything allocated from a child arena since a mark
+ *
+ * \param arena The child arena
+ * \param mark A mark from mavalloc_arena_mark, or 0 to empty the arena
+ * \return None
+ **/
+void mavalloc_arena_reset( struct mavalloc_arena * arena, size_t mark );
+
+/**
+ * @brief Give a child arena back to its parent
+ *
+ * \param arena The child arena
+ * \return None
+ **/
+void mavalloc_arena_destroy( struct mavalloc_arena * arena );
+
+/**
+ * @brief Start a transaction
+ *
+ * Every block allocated from now until the matching commit or rollback 
+ * belongs to the transaction. Transactions can be nested, and rolling 
+ * back an outer transaction also frees the blocks of inner transactions 
+ * that were committed. The mark is shared by the whole arena, not kept 
+ * per thread, so a rollback frees the blocks every thread allocated 
+ * since the mark. Do not use transactions while other threads allocate, 
+ * even with mavalloc_set_thread_safe.
+ *
+ * \param txn Where to save the state to roll back to
+ * \return None
+ **/
+void mavalloc_txn_begin( struct mavalloc_txn * txn );
+
+/**
+ * @brief Keep the blocks of a transaction
+ *
+ * The blocks stay allocated and are freed one by one as usual.
+ *
+ * \param txn The transaction
+ * \return None
+ **/
+void mavalloc_txn_commit( struct mavalloc_txn * txn );
+
+/**
+ * @brief Free every block allocated since a transaction began
+ *
+ * The node list algorithms stamp every allocated node with a serial, so 
+ * the blocks of the transaction are found and freed in one pass over 
+ * the list followed by one coalescing pass, instead of one search per 
+ * mavalloc_free. RING moves its tail back to where it was when the 
+ * transaction began. BITMAP blocks and direct mappings are recorded 
+ * while a transaction is open and freed from that record. Blocks the 
+ * transaction already freed are skipped. Blocks it retired with 
+ * mavalloc_retire stay allocated until reclaiming frees them, so RING 
+ * only moves its tail back to just past the newest of them.
+ *
+ * \param txn The transaction
+ * \return The number of blocks freed
+ **/
+size_t mavalloc_txn_rollback( struct mavalloc_txn * txn );
+
+/**
+ * @brief Claim a reader slot for epoch based reclamation
+ *
+ * \return The reader slot. -1 if all MAVALLOC_EPOCH_READERS slots are taken
+ **/
+int mavalloc_epoch_register( );
+
+/**
+ * @brief Release a reader slot
+ *
+ * \param reader The reader slot
+ * \return None
+ **/
+void mavalloc_epoch_unregister( int reader );
+
+/**
+ * @brief Enter a read side critical section
+ *
+ * Announces the current epoch. Blocks retired after this call are not 
+ * reused until the reader exits, so the reader may keep following 
+ * pointers it loads. The call is one atomic load and store and may be 
+ * made from any thread without a lock.
+ *
+ * \param reader The reader slot
+ * \return None
+ **/
+void mavalloc_epoch_enter( int reader );
+
+/**
+ * @brief Leave a read side critical section
+ *
+ * \param reader The reader slot
+ * \return None
+ **/
+void mavalloc_epoch_exit( int reader );
+
+/**
+ * @brief Free a block once no reader can still be using it
+ *
+ * The block is queued on the list of the current epoch, linked through 
+ * its own first word, so it must be at least sizeof( void * ) bytes and 
+ * queuing needs no memory of its own. When enough blocks are waiting 
+ * the epoch is advanced and the blocks that are safe are freed in one 
+ * batch. Retire is called by the writer, like mavalloc_free.
+ *
+ * \param ptr The block to retire
+ * \return None
+ **/
+void mavalloc_retire( void * ptr );
+
+/**
+ * @brief Free the retired blocks that no reader can still see
+ *
+ * The epoch only moves on when every reader inside a critical section 
+ * has announced the current epoch. Blocks retired two epochs before the 
+ * new one are then sorted in place and freed in one pass, like 
+ * mavalloc_free_batch, without allocating any memory.
+ *
+ * \return The number of blocks freed
+ **/
+size_t mavalloc_epoch_reclaim( );
+
+/**
+ * @brief Free a number of blocks at once
+ *
+ * With the node list algorithms the pointers are sorted and matched 
+ * against the address ordered list in one pass, and the freed blocks 
+ * are merged with their neighbours in a second pass, instead of one 
+ * search per block. The blocks skip the quick-fit lists. The other 
+ * algorithms free the blocks one by one. The order of ptrs is changed.
+ *
+ * \param ptrs The blocks to free
+ * \param count The number of blocks
+ * \return None
+ **/
+void mavalloc_free_batch( void ** ptrs, size_t count );
+
+/**
+ * @brief Serialize the allocator between threads
+ *
+ * When enabled, allocating, freeing, trimming, transactions, retiring 
+ * and the statistics take one recursive arena lock, so several threads 
+ * and the maintenance thread can share the arena. Configuration 
+ * functions are not locked and should be called before the arena is 
+ * shared. Epoch reader calls and child arenas never take the lock. 
+ * The lock does not make transactions per thread, see 
+ * mavalloc_txn_begin. 
+ * Enable or disable it while no other thread is using the allocator.
+ *
+ * \param enabled 1 to take the lock, 0 for single threaded use
+ * \return None
+ **/
+void mavalloc_set_thread_safe( int enabled );
+
+/**
+ * @brief Start the background maintenance thread
+ *
+ * The thread wakes every interval_ms milliseconds, or earlier after a 
+ * burst of frees, and tidies the arena so the calling threads do not 
+ * have to:
+ *
+ * - quick-fit blocks that no allocation used since the last pass are 
+ *   coalesced (deferred coalescing)
+ * - the free tail of a reserved arena is trimmed (see mavalloc_trim) 
+ *   once it stayed idle for a few passes, keeping the last growth step 
+ *   committed
+ * - the whole pages inside large holes of the node list algorithms are 
+ *   given back to the OS with madvise, up to purge_budget bytes a pass
+ *
+ * Live blocks are never moved, since the arena hands out raw pointers. 
+ * Each step takes the arena lock on its own so callers wait at most for 
+ * one step. Starting the thread enables thread safety. Time spent and 
+ * work done are reported in the statistics.
+ *
+ * \param interval_ms The time between passes in milliseconds
+ * \param purge_budget The most bytes of holes purged by one pass
+ * \return 0 on success. -1 if the thread is running or could not start
+ **/
+int mavalloc_maintenance_start( unsigned int interval_ms, size_t purge_budget );
+
+/**
+ * @brief Stop the background maintenance thread
+ *
+ * Waits for a running pass to finish. mavalloc_destroy also stops it.
+ *
+ * \return None
+ **/
+void mavalloc_maintenance_stop( );
+
+/**
+ * @brief Create a pool of page aligned I/O buffers in the arena
+ *
+ * The buffers are carved from one page aligned block of the arena and, 
+ * where the kernel supports it, registered with an io_uring of the pool 
+ * as fixed buffers. Reads and writes then go straight between the file 
+ * and the arena with IORING_OP_READ_FIXED and IORING_OP_WRITE_FIXED, 
+ * with no copy and no pinning of pages on every call. Without io_uring 
+ * the pool falls back to pread and pwrite on the same buffers.
+ *
+ * \param buffer_size The size of each buffer, rounded up to whole pages
+ * \param count The number of buffers
+ * \param flags MAVALLOC_IO_FALLBACK to never use io_uring, or 0
+ * \return The pool. NULL if the arena has no room
+ **/
+struct mavalloc_io_pool * mavalloc_io_pool_create( size_t buffer_size, int count, int flags );
+
+/**
+ * @brief Check whether a pool uses io_uring fixed buffers
+ *
+ * \param pool The pool
+ * \return 1 if reads and writes go through io_uring. 0 if they fall back to pread and pwrite
+ **/
+int mavalloc_io_pool_fixed( struct mavalloc_io_pool * pool );
+
+/**
+ * @brief Take a buffer from a pool
+ *
+ * \param pool The pool
+ * \param buffer Where to store the address, size and index of the buffer
+ * \return 0 on success. -1 if every buffer is in use
+ **/
+int mavalloc_io_pool_get( struct mavalloc_io_pool * pool, struct mavalloc_io_buffer * buffer );
+
+/**
+ * @brief Give a buffer back to its pool
+ *
+ * \param pool The pool
+ * \param buffer The buffer
+ * \return None
+ **/
+void mavalloc_io_pool_put( struct mavalloc_io_pool * pool, struct mavalloc_io_buffer * buffer );
+
+/**
+ * @brief Read from a file into a buffer of a pool
+ *
+ * Works like pread. With io_uring the read is an IORING_OP_READ_FIXED 
+ * on the registered buffer, and the call waits for it to complete. A 
+ * read the kernel refuses as a fixed operation is retried with pread.
+ *
+ * \param pool The pool
+ * \param fd The file
+ * \param buffer The buffer
+ * \param length The number of bytes, at most the size of the buffer
+ * \param offset The offset in the file
+ * \return The number of bytes read, or -1 with errno set
+ **/
+ssize_t mavalloc_io_read( struct mavalloc_io_pool * pool, int fd, const struct mavalloc_io_buffer * buffer, size_t length, off_t offset );
+
+/**
+ * @brief Write a buffer of a pool to a file
+ *
+ * Works like pwrite. With io_uring the write is an 
+ * IORING_OP_WRITE_FIXED on the registered buffer, and the call waits 
+ * for it to complete. A write the kernel refuses as a fixed operation 
+ * is retried with pwrite.
+ *
+ * \param pool The pool
+ * \param fd The file
+ * \param buffer The buffer
+ * \param length The number of bytes, at most the size of the buffer
+ * \param offset The offset in the file
+ * \return The number of bytes written, or -1 with errno set
+ **/
+ssize_t mavalloc_io_write( struct mavalloc_io_pool * pool, int fd, const struct mavalloc_io_buffer * buffer, size_t length, off_t offset );
+
+/**
+ * @brief Destroy a pool and give its buffers back to the arena
+ *
+ * Closing the ring unregisters the buffers. No buffer of the pool may 
+ * be in use.
+ *
+ * \param pool The pool
+ * \return None
+ **/
+void mavalloc_io_pool_destroy( struct mavalloc_io_pool * pool );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,751 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2022 Trevor Bakker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MAVALLOC_HPP
+#define MAVALLOC_HPP
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "mavalloc.h"
+
+namespace mavalloc
+{
+
+/**
+ * @brief std::pmr memory resource backed by an arena
+ *
+ * Without a handle the blocks come from the main arena, which must be
+ * set up with mavalloc_init, and are released with mavalloc_free. With
+ * a child arena handle they come from that child arena, and only
+ * ARENA_STACK children give single blocks back. The alignment asked for
+ * by the container is honoured. Resources are equal when they draw from
+ * the same arena.
+ **/
+class arena_resource : public std::pmr::memory_resource
+{
+public:
+  explicit arena_resource( struct mavalloc_arena * arena = nullptr ) noexcept
+    : arena_( arena )
+  {
+  }
+
+  /**
+   * @brief The child arena the resource draws from
+   *
+   * \return The child arena, or nullptr for the main arena
+   **/
+  struct mavalloc_arena * handle( ) const noexcept
+  {
+    return arena_;
+  }
+
+protected:
+  void * do_allocate( std::size_t bytes, std::size_t alignment ) override
+  {
+    // Zero byte requests still need a unique block
+    if( bytes == 0 ) bytes = 1;
+
+    void * ptr;
+
+    if( arena_ == nullptr ) ptr = mavalloc_alloc_aligned( bytes, alignment );
+    else ptr = mavalloc_arena_alloc_aligned( arena_, bytes, alignment );
+
+    if( ptr == nullptr ) throw std::bad_alloc( );
+
+    return ptr;
+  }
+
+  void do_deallocate( void * ptr, std::size_t, std::size_t ) override
+  {
+    if( arena_ == nullptr ) mavalloc_free( ptr );
+    else mavalloc_arena_free( arena_, ptr );
+  }
+
+  bool do_is_equal( const std::pmr::memory_resource & other ) const noexcept override
+  {
+    const arena_resource * resource = dynamic_cast< const arena_resource * >( &other );
+
+    return resource != nullptr && resource->arena_ == arena_;
+  }
+
+private:
+  struct mavalloc_arena * arena_;
+};
+
+/**
+ * @brief std::pmr memory resource with a lifetime of one scope
+ *
+ * The scope carves an ARENA_BUMP child arena of a fixed size from a
+ * parent arena, the main arena by default. Allocating only moves a
+ * pointer forward and deallocating does nothing, so containers that
+ * live for one request cost no frees and take no lock on the main
+ * arena after the scope is made. Everything is given back at once by
+ * release() or when the scope ends. A full scope throws std::bad_alloc,
+ * like a std::pmr::monotonic_buffer_resource without an upstream.
+ **/
+class monotonic_scope : public std::pmr::memory_resource
+{
+public:
+  explicit monotonic_scope( std::size_t size, struct mavalloc_arena * parent = nullptr )
+    : arena_( mavalloc_arena_create_from( parent, size, ARENA_BUMP ) )
+  {
+    if( arena_ == nullptr ) throw std::bad_alloc( );
+  }
+
+  ~monotonic_scope( ) override
+  {
+    mavalloc_arena_destroy( arena_ );
+  }
+
+  monotonic_scope( const monotonic_scope & ) = delete;
+  monotonic_scope & operator=( const monotonic_scope & ) = delete;
+
+  /**
+   * @brief Free everything allocated from the scope
+   *
+   * Containers still using the scope must not be touched afterwards.
+   **/
+  void release( ) noexcept
+  {
+    mavalloc_arena_reset( arena_, 0 );
+  }
+
+  /**
+   * @brief The child arena of the scope, to nest further arenas in
+   *
+   * \return The child arena
+   **/
+  struct mavalloc_arena * handle( ) const noexcept
+  {
+    return arena_;
+  }
+
+protected:
+  void * do_allocate( std::size_t bytes, std::size_t alignment ) override
+  {
+    void * ptr = mavalloc_arena_alloc_aligned( arena_, bytes, alignment );
+
+    if( ptr == nullptr ) throw std::bad_alloc( );
+
+    return ptr;
+  }
+
+  void do_deallocate( void *, std::size_t, std::size_t ) override
+  {
+  }
+
+  bool do_is_equal( const std::pmr::memory_resource & other ) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  struct mavalloc_arena * arena_;
+};
+
+/**
+ * @brief Pool of objects of one type carved from arena slabs
+ *
+ * The slot size, the alignment and the layout of a slab of N slots are
+ * worked out at compile time, so allocating and freeing a slot is a
+ * pointer pop or push the compiler can inline, with no size rounding or
+ * algorithm dispatch. Slabs come from the main arena as they are
+ * needed and are aligned for T with mavalloc_alloc_aligned, since plain
+ * arena blocks are only word aligned. Freed slots are reused last in,
+ * first out. The slabs go back to the arena when the pool is destroyed,
+ * which does not run the destructors of objects still alive.
+ **/
+template< typename T, std::size_t N = 64 >
+class object_pool
+{
+  static_assert( N > 0, "a slab needs at least one slot" );
+
+  // A free slot holds the link to the next free slot
+  struct free_slot
+  {
+    free_slot * next;
+  };
+
+  // The head of every slab links the slabs of the pool together
+  struct slab_head
+  {
+    slab_head * next;
+  };
+
+  static constexpr std::size_t round_up( std::size_t size, std::size_t align )
+  {
+    return ( size + align - 1 ) / align * align;
+  }
+
+public:
+  // Alignment and size of one slot, large enough for a free slot link
+  static constexpr std::size_t slot_align = alignof( T ) > alignof( free_slot ) ? alignof( T ) : alignof( free_slot );
+  static constexpr std::size_t slot_size = round_up( sizeof( T ) > sizeof( free_slot ) ? sizeof( T ) : sizeof( free_slot ), slot_align );
+
+  // The slots of a slab start after its head, on a slot boundary
+  static constexpr std::size_t slab_offset = round_up( sizeof( slab_head ), slot_align );
+  static constexpr std::size_t slab_size = slab_offset + N * slot_size;
+
+  object_pool( ) noexcept = default;
+
+  ~object_pool( )
+  {
+    while( slabs_ != nullptr )
+    {
+      slab_head * slab = slabs_;
+
+      slabs_ = slab->next;
+      mavalloc_free( slab );
+    }
+  }
+
+  object_pool( const object_pool & ) = delete;
+  object_pool & operator=( const object_pool & ) = delete;
+
+  /**
+   * @brief Construct an object in a slot of the pool
+   *
+   * \param args The arguments for the constructor of T
+   * \return The new object. Throws std::bad_alloc if the arena is full
+   **/
+  template< typename... Args >
+  T * create( Args &&... args )
+  {
+    void * slot = allocate( );
+
+    try
+    {
+      return ::new( slot ) T( std::forward< Args >( args )... );
+    }
+    catch( ... )
+    {
+      deallocate( slot );
+      throw;
+    }
+  }
+
+  /**
+   * @brief Destroy an object made by create and free its slot
+   *
+   * \param object The object, or nullptr
+   **/
+  void destroy( T * object ) noexcept
+  {
+    if( object == nullptr ) return;
+
+    object->~T( );
+    deallocate( object );
+  }
+
+  /**
+   * @brief Take a slot without constructing an object in it
+   *
+   * \return slot_size bytes aligned for T. Throws std::bad_alloc if the arena is full
+   **/
+  void * allocate( )
+  {
+    if( free_ != nullptr )
+    {
+      free_slot * slot = free_;
+
+      free_ = slot->next;
+      return slot;
+    }
+
+    // Slots of the newest slab are handed out in order before the 
+    // free list links them
+    if( next_ == end_ ) grow( );
+
+    void * slot = next_;
+
+    next_ = next_ + slot_size;
+    return slot;
+  }
+
+  /**
+   * @brief Give back a slot taken with allocate
+   *
+   * \param slot The slot
+   **/
+  void deallocate( void * slot ) noexcept
+  {
+    free_slot * node = static_cast< free_slot * >( slot );
+
+    node->next = free_;
+    free_ = node;
+  }
+
+  /**
+   * @brief Number of slabs taken from the arena
+   *
+   * \return The slab count
+   **/
+  std::size_t slabs( ) const noexcept
+  {
+    return slab_count_;
+  }
+
+private:
+  void grow( )
+  {
+    slab_head * slab = static_cast< slab_head * >( mavalloc_alloc_aligned( slab_size, slot_align ) );
+
+    if( slab == nullptr ) throw std::bad_alloc( );
+
+    slab->next = slabs_;
+    slabs_ = slab;
+    slab_count_++;
+
+    next_ = reinterpret_cast< unsigned char * >( slab ) + slab_offset;
+    end_ = next_ + N * slot_size;
+  }
+
+  free_slot * free_ = nullptr;
+  slab_head * slabs_ = nullptr;
+  std::size_t slab_count_ = 0;
+
+  // Slots of the newest slab that were never handed out
+  unsigned char * next_ = nullptr;
+  unsigned char * end_ = nullptr;
+};
+
+
+/**
+ * @brief Thread local cache of coroutine frames sorted by size class
+ *
+ * Frames up to classes * class_size bytes are rounded up to a multiple
+ * of class_size and taken from the main arena. When a frame is freed it
+ * goes on the list of its class for the calling thread, up to depth
+ * frames a class, and the next frame of that class is popped from the
+ * list without touching the arena or its lock. The frame size comes
+ * from the sized operator delete, so frames carry no header. Larger
+ * frames and frames past the depth go straight to mavalloc_free. A
+ * thread gives its cached frames back when it exits or calls drain().
+ * Threads that share the arena need mavalloc_set_thread_safe.
+ **/
+class frame_cache
+{
+public:
+  static constexpr std::size_t class_size = 64;
+  static constexpr std::size_t classes = 16;
+  static constexpr std::size_t depth = 64;
+
+  /**
+   * @brief Allocate a frame
+   *
+   * \param size The size of the frame
+   * \return The frame. Throws std::bad_alloc if the arena is full
+   **/
+  static void * allocate( std::size_t size )
+  {
+    std::size_t index = size_class( size );
+
+    if( index >= classes ) return take( size );
+
+    frame_cache & cache = local( );
+    cache.check( );
+
+    free_frame * frame = cache.lists_[ index ];
+
+    if( frame == nullptr ) return take( ( index + 1 ) * class_size );
+
+    cache.lists_[ index ] = frame->next;
+    cache.counts_[ index ]--;
+
+    return frame;
+  }
+
+  /**
+   * @brief Free a frame made by allocate
+   *
+   * \param ptr The frame
+   * \param size The size the frame was allocated with
+   **/
+  static void deallocate( void * ptr, std::size_t size ) noexcept
+  {
+    std::size_t index = size_class( size );
+
+    if( index >= classes )
+    {
+      mavalloc_free( ptr );
+      return;
+    }
+
+    frame_cache & cache = local( );
+    cache.check( );
+
+    if( cache.counts_[ index ] >= depth )
+    {
+      mavalloc_free( ptr );
+      return;
+    }
+
+    free_frame * frame = static_cast< free_frame * >( ptr );
+
+    frame->next = cache.lists_[ index ];
+    cache.lists_[ index ] = frame;
+    cache.counts_[ index ]++;
+  }
+
+  /**
+   * @brief Give the frames cached by the calling thread back to the arena
+   **/
+  static void drain( ) noexcept
+  {
+    local( ).release( );
+  }
+
+  ~frame_cache( )
+  {
+    release( );
+  }
+
+private:
+  struct free_frame
+  {
+    free_frame * next;
+  };
+
+  static std::size_t size_class( std::size_t size ) noexcept
+  {
+    return ( size == 0 ) ? 0 : ( size - 1 ) / class_size;
+  }
+
+  static frame_cache & local( ) noexcept
+  {
+    static thread_local frame_cache cache;
+
+    return cache;
+  }
+
+  static void * take( std::size_t size )
+  {
+    void * ptr = mavalloc_alloc_aligned( size, __STDCPP_DEFAULT_NEW_ALIGNMENT__ );
+
+    if( ptr == nullptr ) throw std::bad_alloc( );
+
+    return ptr;
+  }
+
+  // Frames cached before the arena was destroyed and set up again no 
+  // longer exist, so they are forgotten
+  void check( ) noexcept
+  {
+    unsigned int generation = mavalloc_generation( );
+
+    if( generation == generation_ ) return;
+
+    forget( );
+    generation_ = generation;
+  }
+
+  void forget( ) noexcept
+  {
+    std::size_t i;
+
+    for( i = 0; i < classes; i++ )
+    {
+      lists_[ i ] = nullptr;
+      counts_[ i ] = 0;
+    }
+  }
+
+  void release( ) noexcept
+  {
+    std::size_t i;
+
+    check( );
+
+    for( i = 0; i < classes; i++ )
+    {
+      while( lists_[ i ] != nullptr )
+      {
+        free_frame * frame = lists_[ i ];
+
+        lists_[ i ] = frame->next;
+        mavalloc_free( frame );
+      }
+
+      counts_[ i ] = 0;
+    }
+  }
+
+  free_frame * lists_[ classes ] = { };
+  std::size_t counts_[ classes ] = { };
+  unsigned int generation_ = 0;
+};
+
+/**
+ * @brief Base for coroutine promise types whose frames live in the arena
+ *
+ * A promise_type that derives from this class has its coroutine frames
+ * allocated through frame_cache instead of the global operator new.
+ **/
+struct frame_promise_base
+{
+  static void * operator new( std::size_t size )
+  {
+    return frame_cache::allocate( size );
+  }
+
+  static void operator delete( void * ptr, std::size_t size ) noexcept
+  {
+    frame_cache::deallocate( ptr, size );
+  }
+};
+
+
+/**
+ * @brief Pool of small blocks of mixed sizes for node based containers
+ *
+ * Blocks of up to classes * class_size bytes are carved from slabs of
+ * slab_size bytes taken from the main arena, and a freed block goes on
+ * the free list of its size class. The caller passes the size back
+ * when freeing, so no block has to be looked up or carry a header, and
+ * the arena only sees one block per slab instead of one per container
+ * node. Larger or more aligned blocks go to the arena directly. The
+ * slabs go back to the arena when the pool is destroyed, so the pool
+ * must outlive the containers using it. A pool is meant for one thread.
+ **/
+class node_pool
+{
+public:
+  static constexpr std::size_t class_size = 16;
+  static constexpr std::size_t classes = 16;
+  static constexpr std::size_t slab_size = 65536;
+
+  node_pool( ) noexcept = default;
+
+  ~node_pool( )
+  {
+    while( slabs_ != nullptr )
+    {
+      slab_head * slab = slabs_;
+
+      slabs_ = slab->next;
+      mavalloc_free( slab );
+    }
+  }
+
+  node_pool( const node_pool & ) = delete;
+  node_pool & operator=( const node_pool & ) = delete;
+
+  /**
+   * @brief Allocate a block
+   *
+   * \param size The size of the block
+   * \param alignment The alignment of the block, a power of two
+   * \return The block. Throws std::bad_alloc if the arena is full
+   **/
+  void * allocate( std::size_t size, std::size_t alignment )
+  {
+    if( size == 0 ) size = 1;
+
+    std::size_t index = ( size - 1 ) / class_size;
+
+    if( index >= classes || alignment > class_size )
+    {
+      void * ptr = mavalloc_alloc_aligned( size, alignment );
+
+      if( ptr == nullptr ) throw std::bad_alloc( );
+
+      return ptr;
+    }
+
+    free_block * block = lists_[ index ];
+
+    if( block != nullptr )
+    {
+      lists_[ index ] = block->next;
+      return block;
+    }
+
+    std::size_t bytes = ( index + 1 ) * class_size;
+
+    // The rest of a slab too small for the block is left unused
+    if( bytes > static_cast< std::size_t >( end_ - next_ ) ) grow( );
+
+    void * ptr = next_;
+
+    next_ = next_ + bytes;
+    return ptr;
+  }
+
+  /**
+   * @brief Free a block made by allocate
+   *
+   * \param ptr The block
+   * \param size The size the block was allocated with
+   * \param alignment The alignment the block was allocated with
+   **/
+  void deallocate( void * ptr, std::size_t size, std::size_t alignment ) noexcept
+  {
+    if( size == 0 ) size = 1;
+
+    std::size_t index = ( size - 1 ) / class_size;
+
+    if( index >= classes || alignment > class_size )
+    {
+      mavalloc_free( ptr );
+      return;
+    }
+
+    free_block * block = static_cast< free_block * >( ptr );
+
+    block->next = lists_[ index ];
+    lists_[ index ] = block;
+  }
+
+  /**
+   * @brief Number of slabs taken from the arena
+   *
+   * \return The slab count
+   **/
+  std::size_t slabs( ) const noexcept
+  {
+    return slab_count_;
+  }
+
+private:
+  struct free_block
+  {
+    free_block * next;
+  };
+
+  struct slab_head
+  {
+    slab_head * next;
+  };
+
+  void grow( )
+  {
+    slab_head * slab = static_cast< slab_head * >( mavalloc_alloc_aligned( slab_size, class_size ) );
+
+    if( slab == nullptr ) throw std::bad_alloc( );
+
+    slab->next = slabs_;
+    slabs_ = slab;
+    slab_count_++;
+
+    // Blocks start after the head, on a class boundary
+    next_ = reinterpret_cast< unsigned char * >( slab ) + class_size;
+    end_ = reinterpret_cast< unsigned char * >( slab ) + slab_size;
+  }
+
+  free_block * lists_[ classes ] = { };
+  slab_head * slabs_ = nullptr;
+  std::size_t slab_count_ = 0;
+
+  // Unused part of the newest slab
+  unsigned char * next_ = nullptr;
+  unsigned char * end_ = nullptr;
+};
+
+/**
+ * @brief Standard allocator over the arena
+ *
+ * The state of the allocator is the node_pool it draws from. Without a
+ * pool every allocation is its own arena block, which suits the few
+ * large blocks of std::vector. With a pool the nodes of std::map,
+ * std::list or std::unordered_map come from its slabs, and deallocate
+ * hands the size back so the block goes straight onto its free list.
+ * Allocators are equal when they share a pool. The pool follows the
+ * contents on move assignment and swap, so containers on different
+ * pools can be moved into each other without copying.
+ **/
+template< typename T >
+class allocator
+{
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  allocator( ) noexcept = default;
+
+  explicit allocator( node_pool * pool ) noexcept
+    : pool_( pool )
+  {
+  }
+
+  template< typename U >
+  allocator( const allocator< U > & other ) noexcept
+    : pool_( other.pool( ) )
+  {
+  }
+
+  T * allocate( std::size_t n )
+  {
+    if( n > std::numeric_limits< std::size_t >::max( ) / sizeof( T ) ) throw std::bad_array_new_length( );
+
+    if( pool_ != nullptr ) return static_cast< T * >( pool_->allocate( n * sizeof( T ), alignof( T ) ) );
+
+    // Zero element requests still need a unique block
+    void * ptr = mavalloc_alloc_aligned( ( n > 0 ) ? n * sizeof( T ) : 1, alignof( T ) );
+
+    if( ptr == nullptr ) throw std::bad_alloc( );
+
+    return static_cast< T * >( ptr );
+  }
+
+  void deallocate( T * ptr, std::size_t n ) noexcept
+  {
+    if( pool_ != nullptr ) pool_->deallocate( ptr, n * sizeof( T ), alignof( T ) );
+    else mavalloc_free( ptr );
+  }
+
+  /**
+   * @brief The pool the allocator draws from
+   *
+   * \return The pool, or nullptr for plain arena blocks
+   **/
+  node_pool * pool( ) const noexcept
+  {
+    return pool_;
+  }
+
+private:
+  node_pool * pool_ = nullptr;
+};
+
+template< typename T, typename U >
+bool operator==( const allocator< T > & a, const allocator< U > & b ) noexcept
+{
+  return a.pool( ) == b.pool( );
+}
+
+template< typename T, typename U >
+bool operator!=( const allocator< T > & a, const allocator< U > & b ) noexcept
+{
+  return a.pool( ) != b.pool( );
+}
+
+}
+
+#endif